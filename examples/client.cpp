@@ -16,7 +16,8 @@ enum ExecutionMode
     NORMAL      = 0,
     READ_DELAY  = 1,
     WRITE_DELAY = 2,
-    SUMMARIZE   = 3
+    SUMMARIZE   = 3,
+    STOP        = 4
 };
 
 int basicLoop(ExecutionMode mode)
@@ -40,7 +41,7 @@ int basicLoop(ExecutionMode mode)
             return 0;
         }
         ostringstream output;
-        output<<nLines+1<<"\n";
+        output<<nLines+1<<(mode == STOP ? "\tSTOP\n" : "\n");
         size_t i;
         for( i =0 ; i<nLines; ++i)
         {
@@ -134,6 +135,10 @@ int main(int argc, char* argv[])
         {
             return basicLoop(WRITE_DELAY);
         }
+        else if (modeString == "STOP")
+        {
+            return basicLoop(STOP);
+        }
         else if (modeString == "SUMMARIZE")
         {
             return summarizeLoop();
@@ -0,0 +1,303 @@
+// Grisu2 shortest round-trip formatting of double and float.
+//
+// The algorithm is Grisu2 from Florian Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers", PLDI 2010. This
+// implementation follows the one by Milo Yip in dtoa-benchmark and RapidJSON,
+// released under the MIT license:
+//
+// Copyright (C) 2014 Milo Yip
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Modification notice:
+// Reduced to the digit generation, header-only, and extended to float by
+// taking the significand width and exponent bias from the type.
+
+#ifndef GRISU2_H_
+#define GRISU2_H_
+
+#include <stdint.h>
+#include <string.h>
+
+namespace grisu2 {
+namespace detail {
+
+struct DiyFp
+{
+    DiyFp() : f(0), e(0) {}
+    DiyFp(uint64_t fp, int exp) : f(fp), e(exp) {}
+
+    DiyFp operator-(DiyFp const& rhs) const
+    {
+        return DiyFp(f - rhs.f, e);
+    }
+
+    DiyFp operator*(DiyFp const& rhs) const
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 p = static_cast<unsigned __int128>(f) * rhs.f;
+        uint64_t h = static_cast<uint64_t>(p >> 64);
+        uint64_t l = static_cast<uint64_t>(p);
+        if (l & (uint64_t(1) << 63)) // rounding
+            h++;
+        return DiyFp(h, e + rhs.e + 64);
+#else
+        const uint64_t M32 = 0xFFFFFFFF;
+        const uint64_t a = f >> 32;
+        const uint64_t b = f & M32;
+        const uint64_t c = rhs.f >> 32;
+        const uint64_t d = rhs.f & M32;
+        const uint64_t ac = a * c;
+        const uint64_t bc = b * c;
+        const uint64_t ad = a * d;
+        const uint64_t bd = b * d;
+        uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+        tmp += 1U << 31; // rounding
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+#endif
+    }
+
+    DiyFp Normalize() const
+    {
+        DiyFp res = *this;
+        while (!(res.f & (uint64_t(1) << 63)))
+        {
+            res.f <<= 1;
+            res.e--;
+        }
+        return res;
+    }
+
+    uint64_t f;
+    int e;
+};
+
+// The significand width and exponent bias of an IEEE binary format.
+template <typename T> struct Traits;
+
+template <> struct Traits<double>
+{
+    typedef uint64_t Bits;
+    static const int kSignificandSize = 52;
+    static const int kExponentBias = 0x3FF + kSignificandSize;
+    static const Bits kExponentMask = UINT64_C(0x7FF0000000000000);
+    static const Bits kSignificandMask = UINT64_C(0x000FFFFFFFFFFFFF);
+};
+
+template <> struct Traits<float>
+{
+    typedef uint32_t Bits;
+    static const int kSignificandSize = 23;
+    static const int kExponentBias = 0x7F + kSignificandSize;
+    static const Bits kExponentMask = 0x7F800000;
+    static const Bits kSignificandMask = 0x007FFFFF;
+};
+
+template <typename T>
+inline void NormalizedBoundaries(T value, DiyFp* v, DiyFp* minus, DiyFp* plus)
+{
+    typedef Traits<T> Tr;
+    typename Tr::Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint64_t hidden = uint64_t(1) << Tr::kSignificandSize;
+    const int biasedE = static_cast<int>((bits & Tr::kExponentMask) >> Tr::kSignificandSize);
+    const uint64_t significand = bits & Tr::kSignificandMask;
+    if (biasedE != 0)
+    {
+        v->f = significand + hidden;
+        v->e = biasedE - Tr::kExponentBias;
+    }
+    else
+    {
+        v->f = significand;
+        v->e = 1 - Tr::kExponentBias;
+    }
+
+    DiyFp pl((v->f << 1) + 1, v->e - 1);
+    while (!(pl.f & (hidden << 1)))
+    {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - Tr::kSignificandSize - 2;
+    pl.e -= 64 - Tr::kSignificandSize - 2;
+    DiyFp mi = (v->f == hidden) ? DiyFp((v->f << 2) - 1, v->e - 2) : DiyFp((v->f << 1) - 1, v->e - 1);
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    *plus = pl;
+    *minus = mi;
+}
+
+inline DiyFp GetCachedPower(int e, int* K)
+{
+    // 10^-348, 10^-340, ..., 10^340
+    static const uint64_t kCachedPowers_F[] = {
+        UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76), UINT64_C(0xcf42894a5dce35ea),
+        UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df), UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f),
+        UINT64_C(0xbe5691ef416bd60c), UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+        UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57), UINT64_C(0xc21094364dfb5637),
+        UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7), UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5),
+        UINT64_C(0xb23867fb2a35b28e), UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+        UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126), UINT64_C(0xb5b5ada8aaff80b8),
+        UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053), UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd),
+        UINT64_C(0xa6dfbd9fb8e5b88f), UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+        UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06), UINT64_C(0xaa242499697392d3),
+        UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb), UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c),
+        UINT64_C(0x9c40000000000000), UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+        UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068), UINT64_C(0x9f4f2726179a2245),
+        UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8), UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a),
+        UINT64_C(0x924d692ca61be758), UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+        UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d), UINT64_C(0x952ab45cfa97a0b3),
+        UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25), UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece),
+        UINT64_C(0x88fcf317f22241e2), UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+        UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410), UINT64_C(0x8bab8eefb6409c1a),
+        UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129), UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429),
+        UINT64_C(0x80444b5e7aa7cf85), UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+        UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b)
+    };
+    static const int16_t kCachedPowers_E[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007,  -980,
+         -954,  -927,  -901,  -874,  -847,  -821,  -794,  -768,  -741,  -715,
+         -688,  -661,  -635,  -608,  -582,  -555,  -529,  -502,  -475,  -449,
+         -422,  -396,  -369,  -343,  -316,  -289,  -263,  -236,  -210,  -183,
+         -157,  -130,  -103,   -77,   -50,   -24,     3,    30,    56,    83,
+          109,   136,   162,   189,   216,   242,   269,   295,   322,   348,
+          375,   402,   428,   455,   481,   508,   534,   561,   588,   614,
+          641,   667,   694,   720,   747,   774,   800,   827,   853,   880,
+          907,   933,   960,   986,  1013,  1039,  1066
+    };
+
+    double dk = (-61 - e) * 0.30102999566398114 + 347; // dk must be positive, so can do ceiling in positive
+    int k = static_cast<int>(dk);
+    if (dk - k > 0.0)
+        k++;
+
+    unsigned index = static_cast<unsigned>((k >> 3) + 1);
+    *K = -(-348 + static_cast<int>(index << 3)); // decimal exponent no need lookup table
+
+    return DiyFp(kCachedPowers_F[index], kCachedPowers_E[index]);
+}
+
+inline void GrisuRound(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || // closer
+            wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+inline int CountDecimalDigit32(uint32_t n)
+{
+    if (n < 10) return 1;
+    if (n < 100) return 2;
+    if (n < 1000) return 3;
+    if (n < 10000) return 4;
+    if (n < 100000) return 5;
+    if (n < 1000000) return 6;
+    if (n < 10000000) return 7;
+    if (n < 100000000) return 8;
+    if (n < 1000000000) return 9;
+    return 10;
+}
+
+inline void DigitGen(DiyFp const& W, DiyFp const& Mp, uint64_t delta, char* buffer, int* len, int* K)
+{
+    static const uint64_t kPow10[] = { UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+                                       UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+                                       UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+                                       UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+                                       UINT64_C(1000000000000000), UINT64_C(10000000000000000),
+                                       UINT64_C(100000000000000000), UINT64_C(1000000000000000000),
+                                       UINT64_C(10000000000000000000) };
+    const DiyFp one(uint64_t(1) << -Mp.e, Mp.e);
+    const DiyFp wp_w = Mp - W;
+    uint32_t p1 = static_cast<uint32_t>(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    int kappa = CountDecimalDigit32(p1);
+    *len = 0;
+
+    while (kappa > 0)
+    {
+        uint32_t const pow10 = static_cast<uint32_t>(kPow10[kappa - 1]);
+        uint32_t const d = p1 / pow10;
+        p1 %= pow10;
+        if (d || *len)
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        kappa--;
+        uint64_t tmp = (static_cast<uint64_t>(p1) << -one.e) + p2;
+        if (tmp <= delta)
+        {
+            *K += kappa;
+            GrisuRound(buffer, *len, delta, tmp, kPow10[kappa] << -one.e, wp_w.f);
+            return;
+        }
+    }
+
+    // kappa = 0
+    for (;;)
+    {
+        p2 *= 10;
+        delta *= 10;
+        char d = static_cast<char>(p2 >> -one.e);
+        if (d || *len)
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta)
+        {
+            *K += kappa;
+            int const index = -kappa;
+            GrisuRound(buffer, *len, delta, p2, one.f, wp_w.f * (index < 20 ? kPow10[index] : 0));
+            return;
+        }
+    }
+}
+
+} // namespace detail
+
+/**
+ * Write the shortest decimal digits that read back to value, as nearly always, and never more than 17 digits for a
+ * double or 9 for a float. value must be finite and greater than zero.
+ * @param buffer room for at least 18 characters; the digits are not terminated
+ * @param[out] K the decimal exponent, so that value is the digits times 10^K
+ * @return the number of digits
+ */
+template <typename T>
+inline int Grisu2(T value, char* buffer, int* K)
+{
+    detail::DiyFp v, w_m, w_p;
+    detail::NormalizedBoundaries(value, &v, &w_m, &w_p);
+
+    const detail::DiyFp c_mk = detail::GetCachedPower(w_p.e, K);
+    const detail::DiyFp W = v.Normalize() * c_mk;
+    detail::DiyFp Wp = w_p * c_mk;
+    detail::DiyFp Wm = w_m * c_mk;
+    Wm.f++;
+    Wp.f--;
+    int length;
+    detail::DigitGen(W, Wp, Wp.f - Wm.f, buffer, &length, K);
+    return length;
+}
+
+} // namespace grisu2
+
+#endif // GRISU2_H_
@@ -22,6 +22,8 @@
 # END_COPYRIGHT
 
 import dill
+import mmap
+import os
 import struct
 import sys
 import pyarrow
@@ -31,7 +33,6 @@ import pyarrow
 try:
     import numpy
 except KeyError:
-    import os
     os.environ.setdefault('PATH', '')
     import numpy
 
@@ -59,40 +60,151 @@ else:
     stdout = sys.stdout
 
 
+SIDE_INPUT_VAR = 'SCIDB_STREAM_SIDE_INPUT'
+COMPRESSION_VAR = 'SCIDB_STREAM_COMPRESSION'
+
+# Set in the size of a response to ask SciDB not to send any more data
+STOP_FLAG = 1 << 63
+_stop_requested = False
+
+
+class _InputStream(object):
+    """The Arrow IPC stream from one source, cut into size-prefixed
+    messages. Its schema comes with the first message, and again when it
+    changes; the other messages carry only record batches, and the
+    dictionaries of dictionary-encoded string columns, which are read as
+    categoricals.
+
+    """
+    def __init__(self):
+        self.schema = None
+
+    def read(self, source):
+        sz = struct.unpack('<Q', source.read(8))[0]
+
+        if not sz:              # Last Chunk
+            return None
+
+        if hasattr(source, 'read_buffer'):
+            body = source.read_buffer(sz)
+        else:
+            body = pyarrow.py_buffer(source.read(sz))
+        messages = list(pyarrow.ipc.MessageReader.open_stream(body))
+        with_schema = messages and messages[0].type == 'schema'
+        if with_schema:
+            self.schema = pyarrow.ipc.read_schema(messages[0])
+        if any(message.type == 'dictionary' for message in messages):
+            # Dictionaries are decoded by a stream reader, which needs
+            # the schema in front of them
+            if not with_schema:
+                body = pyarrow.py_buffer(
+                    self.schema.serialize().to_pybytes() + body.to_pybytes())
+            return pyarrow.ipc.open_stream(body).read_pandas()
+        batches = [pyarrow.ipc.read_record_batch(message, self.schema)
+                   for message in messages
+                   if message.type == 'record batch']
+        return pyarrow.Table.from_batches(batches, self.schema).to_pandas()
+
+
+class _OutputStream(object):
+    """The Arrow IPC stream of the responses. The writer puts the schema
+    in front of the first record batch, and again after the schema
+    changes; each message takes the bytes written since the last one.
+    Record batches are compressed with the codec SciDB uses, if any. A
+    table with dictionary columns, such as categoricals, starts a new
+    stream, so that its message holds its own dictionaries and can be
+    replayed from the result cache on its own.
+
+    """
+    def __init__(self):
+        self.parts = []
+        self.schema = None
+        self.writer = None
+        self.closed = False
+        compression = os.environ.get(COMPRESSION_VAR)
+        self.options = pyarrow.ipc.IpcWriteOptions(
+            compression=compression or None)
+
+    def write(self, data):
+        self.parts.append(bytes(data))
+        return len(data)
+
+    def flush(self):
+        pass
+
+    def message(self, table):
+        dictionaries = any(pyarrow.types.is_dictionary(field.type)
+                           for field in table.schema)
+        if (dictionaries or self.schema is None or
+                not table.schema.equals(self.schema)):
+            self.schema = table.schema
+            self.writer = pyarrow.ipc.new_stream(
+                self, self.schema, options=self.options)
+        for batch in table.combine_chunks().to_batches():
+            self.writer.write_batch(batch)
+        parts, self.parts = self.parts, []
+        return parts
+
+
+_input = _InputStream()
+_output = None
+
+
 def read():
     """Read a data chunk from SciDB. Returns a Pandas DataFrame or None.
 
     """
-    sz = struct.unpack('<Q', stdin.read(8))[0]
+    return _input.read(stdin)
+
 
-    if sz:
-        stream = pyarrow.ipc.open_stream(stdin)
-        df = stream.read_pandas()
-        return df
+def read_side():
+    """Read the first chunk of the side input cached by SciDB when the
+    operator runs with `side_cache:true`. The cache file is mapped
+    rather than copied. Returns a Pandas DataFrame, or None if there is
+    no cached side input.
 
-    else:                       # Last Chunk
+    """
+    path = os.environ.get(SIDE_INPUT_VAR)
+    if not path:
         return None
+    with open(path, 'rb') as f:
+        buf = pyarrow.py_buffer(
+            mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ))
+    return _InputStream().read(pyarrow.BufferReader(buf))
 
 
 def write(df=None):
-    """Write a data chunk to SciDB.
+    """Write a data chunk to SciDB. The schema is only sent with the
+    first chunk, or when it changes.
 
     """
+    global _output
+    flag = STOP_FLAG if _stop_requested else 0
+
     if df is None:
-        stdout.write(struct.pack('<Q', 0))
+        stdout.write(struct.pack('<Q', flag))
         return
 
-    buf = pyarrow.BufferOutputStream()
     table = pyarrow.Table.from_pandas(df)
     table = table.replace_schema_metadata()  # Remove metadata
-    writer = pyarrow.RecordBatchStreamWriter(buf, table.schema)
-    writer.write_table(table)
-    writer.close()
-    byt = buf.getvalue().to_pybytes()
-    sz = len(byt)
+    if _output is None:
+        _output = _OutputStream()
+    parts = _output.message(table)
+    sz = sum(len(part) for part in parts)
 
-    stdout.write(struct.pack('<Q', sz))
-    stdout.write(byt)
+    stdout.write(struct.pack('<Q', sz | flag))
+    for part in parts:
+        stdout.write(part)
+
+
+def request_stop():
+    """Ask SciDB not to send any more data chunks. The flag is sent with
+    the next response; SciDB then skips the remaining chunks and sends
+    the final empty chunk, so `map` still calls `finalize_fun`.
+
+    """
+    global _stop_requested
+    _stop_requested = True
 
 
 def pack_func(func):
@@ -106,9 +218,14 @@ def pack_func(func):
 
 
 def read_func():
-    """Read and de-serialize function from SciDB.
+    """Read and de-serialize function from SciDB. The function is taken
+    from the cached side input, if any, in which case no message is
+    sent back.
 
     """
+    df = read_side()
+    if df is not None:
+        return dill.loads(df.iloc[0, 0])
     func = dill.loads(read().iloc[0, 0])
     write()                     # SciDB expects a message back
     return func
@@ -0,0 +1,588 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * Native reader and writer for the data.frame messages of the stream plugin (format:'df'). The plugin writes a
+ * fixed subset of R serialization version 2: a list of integer, logical, double and character vectors, with the
+ * class attribute on integer64 and POSIXct columns, the levels and class attributes on factors and the names
+ * attribute on the list. Decoding that subset
+ * directly into a data.frame avoids unserialize, data.frame() and the copies between them; encoding the response
+ * straight from the returned data.frame avoids serialize and writeBin.
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* R serialization item types and flags */
+#define TYPE_MASK     0xff
+#define IS_OBJECT     0x100
+#define HAS_ATTR      0x200
+#define HAS_TAG       0x400
+#define SYM_TYPE      1
+#define LIST_TYPE     2
+#define CHAR_TYPE     9
+#define LGL_TYPE      10
+#define INT_TYPE      13
+#define REAL_TYPE     14
+#define STR_TYPE      16
+#define VEC_TYPE      19
+#define NILVALUE_TYPE 254
+#define REF_TYPE      255
+
+/* encoding bits in the levels of a CHARSXP, as R writes them */
+#define BYTES_MASK    (1 << 1)
+#define LATIN1_MASK   (1 << 2)
+#define UTF8_MASK     (1 << 3)
+#define ASCII_MASK    (1 << 6)
+
+#define MAX_SYMBOLS   256
+
+static const unsigned char HEADER[14] = { 0x42, 0x0a, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x00, 0x00, 0x03, 0x02, 0x00 };
+
+/* A window over a message; refilled from fd when it runs out, unless fd is negative */
+typedef struct
+{
+    unsigned char* data;
+    size_t         pos;
+    size_t         end;
+    size_t         cap;
+    int            fd;
+    SEXP           symbols[MAX_SYMBOLS];
+    int            nSymbols;
+} reader_t;
+
+typedef struct
+{
+    unsigned char* data;
+    size_t         size;
+    size_t         cap;
+} writer_t;
+
+/* kept across messages so that the buffers are allocated once per process */
+static reader_t stdinReader = { NULL, 0, 0, 0, 0, { NULL }, 0 };
+static writer_t stdoutWriter = { NULL, 0, 0 };
+
+static void need(reader_t* r, size_t n)
+{
+    if(r->end - r->pos >= n)
+    {
+        return;
+    }
+    if(r->fd < 0)
+    {
+        error("scidbstrm: truncated message");
+    }
+    if(r->pos > 0)
+    {
+        memmove(r->data, r->data + r->pos, r->end - r->pos);
+        r->end -= r->pos;
+        r->pos = 0;
+    }
+    if(n > r->cap)
+    {
+        size_t cap = r->cap ? r->cap : 1024 * 1024;
+        while(cap < n)
+        {
+            cap *= 2;
+        }
+        unsigned char* data = (unsigned char*) realloc(r->data, cap);
+        if(data == NULL)
+        {
+            error("scidbstrm: out of memory reading a message of %.0f bytes", (double) n);
+        }
+        r->data = data;
+        r->cap = cap;
+    }
+    while(r->end - r->pos < n)
+    {
+        ssize_t got = read(r->fd, r->data + r->end, r->cap - r->end);
+        if(got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(got <= 0)
+        {
+            error("scidbstrm: could not read from SciDB");
+        }
+        r->end += got;
+    }
+}
+
+static int32_t readInt(reader_t* r)
+{
+    int32_t v;
+    need(r, sizeof(int32_t));
+    memcpy(&v, r->data + r->pos, sizeof(int32_t));
+    r->pos += sizeof(int32_t);
+    return v;
+}
+
+static void readBytes(reader_t* r, void* dest, size_t n)
+{
+    need(r, n);
+    memcpy(dest, r->data + r->pos, n);
+    r->pos += n;
+}
+
+static int32_t readLength(reader_t* r)
+{
+    int32_t length = readInt(r);
+    if(length < 0)
+    {
+        error("scidbstrm: long vectors are not supported");
+    }
+    return length;
+}
+
+static SEXP readChars(reader_t* r)
+{
+    int32_t flags = readInt(r);
+    int32_t size = readInt(r);
+    int levels = flags >> 12;
+    cetype_t encoding = CE_NATIVE;
+    if((flags & TYPE_MASK) != CHAR_TYPE || size < -1)
+    {
+        error("scidbstrm: malformed string");
+    }
+    if(size == -1)
+    {
+        return NA_STRING;
+    }
+    if(levels & UTF8_MASK)
+    {
+        encoding = CE_UTF8;
+    }
+    else if(levels & LATIN1_MASK)
+    {
+        encoding = CE_LATIN1;
+    }
+    else if(levels & BYTES_MASK)
+    {
+        encoding = CE_BYTES;
+    }
+    need(r, size);
+    SEXP chars = mkCharLenCE((char const*) r->data + r->pos, size, encoding);
+    r->pos += size;
+    return chars;
+}
+
+static SEXP readSymbol(reader_t* r)
+{
+    int32_t flags = readInt(r);
+    if((flags & TYPE_MASK) == REF_TYPE)
+    {
+        int idx = ((uint32_t) flags) >> 8;
+        if(idx == 0)
+        {
+            idx = readInt(r);
+        }
+        if(idx < 1 || idx > r->nSymbols)
+        {
+            error("scidbstrm: invalid symbol reference");
+        }
+        return r->symbols[idx - 1];
+    }
+    if((flags & TYPE_MASK) != SYM_TYPE)
+    {
+        error("scidbstrm: malformed attribute name");
+    }
+    if(r->nSymbols == MAX_SYMBOLS)
+    {
+        error("scidbstrm: too many symbols in a message");
+    }
+    /* installed symbols are never collected, so they need no protection */
+    SEXP symbol = installChar(readChars(r));
+    r->symbols[r->nSymbols++] = symbol;
+    return symbol;
+}
+
+/* a vector without attributes of its own, or with a pairlist of attributes following its data */
+static SEXP readVector(reader_t* r, int32_t flags);
+
+static void readAttributes(reader_t* r, SEXP x)
+{
+    while(1)
+    {
+        int32_t flags = readInt(r);
+        if((flags & TYPE_MASK) == NILVALUE_TYPE)
+        {
+            return;
+        }
+        if((flags & TYPE_MASK) != LIST_TYPE || (flags & HAS_ATTR) || !(flags & HAS_TAG))
+        {
+            error("scidbstrm: malformed attributes");
+        }
+        SEXP tag = readSymbol(r);
+        SEXP value = PROTECT(readVector(r, readInt(r)));
+        setAttrib(x, tag, value);
+        UNPROTECT(1);
+    }
+}
+
+static SEXP readVector(reader_t* r, int32_t flags)
+{
+    SEXP x;
+    int32_t i;
+    int32_t length;
+    switch(flags & TYPE_MASK)
+    {
+    case LGL_TYPE:
+        length = readLength(r);
+        x = PROTECT(allocVector(LGLSXP, length));
+        readBytes(r, LOGICAL(x), length * sizeof(int));
+        break;
+    case INT_TYPE:
+        length = readLength(r);
+        x = PROTECT(allocVector(INTSXP, length));
+        readBytes(r, INTEGER(x), length * sizeof(int));
+        break;
+    case REAL_TYPE:
+        length = readLength(r);
+        x = PROTECT(allocVector(REALSXP, length));
+        readBytes(r, REAL(x), length * sizeof(double));
+        break;
+    case STR_TYPE:
+        length = readLength(r);
+        x = PROTECT(allocVector(STRSXP, length));
+        for(i = 0; i < length; ++i)
+        {
+            SET_STRING_ELT(x, i, readChars(r));
+        }
+        break;
+    default:
+        error("scidbstrm: unsupported column type %d", flags & TYPE_MASK);
+    }
+    if(flags & HAS_ATTR)
+    {
+        readAttributes(r, x);
+    }
+    UNPROTECT(1);
+    return x;
+}
+
+/* decode one message into a data.frame; the empty list that ends the stream becomes a data.frame without rows */
+static SEXP readDataFrame(reader_t* r)
+{
+    unsigned char header[sizeof(HEADER)];
+    int32_t flags;
+    int32_t nColumns;
+    int32_t nRows = 0;
+    int32_t i;
+    r->nSymbols = 0;
+    readBytes(r, header, sizeof(HEADER));
+    if(header[0] != HEADER[0] || header[1] != HEADER[1])
+    {
+        error("scidbstrm: expected a binary R serialization");
+    }
+    flags = readInt(r);
+    if((flags & TYPE_MASK) != VEC_TYPE)
+    {
+        error("scidbstrm: expected a list");
+    }
+    nColumns = readLength(r);
+    SEXP df = PROTECT(allocVector(VECSXP, nColumns));
+    for(i = 0; i < nColumns; ++i)
+    {
+        SEXP column = readVector(r, readInt(r));
+        SET_VECTOR_ELT(df, i, column);
+        if(i == 0)
+        {
+            nRows = LENGTH(column);
+        }
+        else if(LENGTH(column) != nRows)
+        {
+            error("scidbstrm: columns of different lengths");
+        }
+    }
+    if(flags & HAS_ATTR)
+    {
+        readAttributes(r, df);
+    }
+    /* the compact form of automatic row names, as data.frame() makes them */
+    SEXP rowNames = PROTECT(allocVector(INTSXP, nRows > 0 ? 2 : 0));
+    if(nRows > 0)
+    {
+        INTEGER(rowNames)[0] = NA_INTEGER;
+        INTEGER(rowNames)[1] = -nRows;
+    }
+    setAttrib(df, R_RowNamesSymbol, rowNames);
+    if(getAttrib(df, R_NamesSymbol) == R_NilValue)
+    {
+        setAttrib(df, R_NamesSymbol, allocVector(STRSXP, nColumns));
+    }
+    setAttrib(df, R_ClassSymbol, mkString("data.frame"));
+    UNPROTECT(2);
+    return df;
+}
+
+static void reserve(writer_t* w, size_t n)
+{
+    if(w->size + n <= w->cap)
+    {
+        return;
+    }
+    size_t cap = w->cap ? w->cap : 1024 * 1024;
+    while(cap < w->size + n)
+    {
+        cap *= 2;
+    }
+    unsigned char* data = (unsigned char*) realloc(w->data, cap);
+    if(data == NULL)
+    {
+        error("scidbstrm: out of memory writing a message of %.0f bytes", (double) (w->size + n));
+    }
+    w->data = data;
+    w->cap = cap;
+}
+
+static void writeBytes(writer_t* w, void const* data, size_t n)
+{
+    reserve(w, n);
+    memcpy(w->data + w->size, data, n);
+    w->size += n;
+}
+
+static void writeInt(writer_t* w, int32_t v)
+{
+    writeBytes(w, &v, sizeof(int32_t));
+}
+
+static void writeChars(writer_t* w, SEXP chars)
+{
+    if(chars == NA_STRING)
+    {
+        writeInt(w, CHAR_TYPE);
+        writeInt(w, -1);
+        return;
+    }
+    /* SciDB strings are UTF-8; plain ASCII goes as is, anything else is translated */
+    char const* text = CHAR(chars);
+    size_t size = LENGTH(chars);
+    int levels = UTF8_MASK;
+    if(getCharCE(chars) != CE_UTF8)
+    {
+        size_t i;
+        for(i = 0; i < size && ((unsigned char) text[i]) < 128; ++i);
+        if(i == size)
+        {
+            levels = ASCII_MASK;
+        }
+        else
+        {
+            text = translateCharUTF8(chars);
+            size = strlen(text);
+        }
+    }
+    writeInt(w, CHAR_TYPE | (levels << 12));
+    writeInt(w, (int32_t) size);
+    writeBytes(w, text, size);
+}
+
+static void writeSymbol(writer_t* w, char const* name)
+{
+    writeInt(w, SYM_TYPE);
+    writeChars(w, mkChar(name));
+}
+
+static void writeStrings(writer_t* w, SEXP x)
+{
+    R_xlen_t i;
+    R_xlen_t n = XLENGTH(x);
+    writeInt(w, STR_TYPE);
+    writeInt(w, (int32_t) n);
+    for(i = 0; i < n; ++i)
+    {
+        writeChars(w, STRING_ELT(x, i));
+    }
+}
+
+static void writeColumn(writer_t* w, SEXP column, int idx)
+{
+    R_xlen_t n = XLENGTH(column);
+    int classed = TYPEOF(column) == REALSXP && (inherits(column, "integer64") || inherits(column, "POSIXct"));
+    if(n > INT_MAX)
+    {
+        error("scidbstrm: column %d is a long vector", idx + 1);
+    }
+    switch(TYPEOF(column))
+    {
+    case LGLSXP:
+        writeInt(w, LGL_TYPE);
+        writeInt(w, (int32_t) n);
+        writeBytes(w, LOGICAL(column), n * sizeof(int));
+        break;
+    case INTSXP:
+        /* a factor goes with its levels, which SciDB stores for a string attribute */
+        writeInt(w, INT_TYPE | (isFactor(column) ? IS_OBJECT | HAS_ATTR : 0));
+        writeInt(w, (int32_t) n);
+        writeBytes(w, INTEGER(column), n * sizeof(int));
+        if(isFactor(column))
+        {
+            writeInt(w, LIST_TYPE | HAS_TAG);
+            writeSymbol(w, "levels");
+            writeStrings(w, getAttrib(column, R_LevelsSymbol));
+            writeInt(w, LIST_TYPE | HAS_TAG);
+            writeSymbol(w, "class");
+            writeInt(w, STR_TYPE);
+            writeInt(w, 1);
+            writeChars(w, mkChar("factor"));
+            writeInt(w, NILVALUE_TYPE);
+        }
+        break;
+    case REALSXP:
+        writeInt(w, REAL_TYPE | (classed ? IS_OBJECT | HAS_ATTR : 0));
+        writeInt(w, (int32_t) n);
+        writeBytes(w, REAL(column), n * sizeof(double));
+        if(classed)
+        {
+            writeInt(w, LIST_TYPE | HAS_TAG);
+            writeSymbol(w, "class");
+            writeStrings(w, getAttrib(column, R_ClassSymbol));
+            writeInt(w, NILVALUE_TYPE);
+        }
+        break;
+    case STRSXP:
+        writeStrings(w, column);
+        break;
+    default:
+        error("scidbstrm: column %d has unsupported type %s", idx + 1, type2char(TYPEOF(column)));
+    }
+}
+
+/* encode a list or data.frame of columns, with its names and the stop request of requestStop() if any */
+static void writeDataFrame(writer_t* w, SEXP x)
+{
+    int i;
+    int n;
+    SEXP names;
+    SEXP stop;
+    int hasStop;
+    if(x != R_NilValue && TYPEOF(x) != VECSXP)
+    {
+        error("scidbstrm: expected a list or data.frame");
+    }
+    n = x == R_NilValue ? 0 : LENGTH(x);
+    names = x == R_NilValue ? R_NilValue : getAttrib(x, R_NamesSymbol);
+    stop = x == R_NilValue ? R_NilValue : getAttrib(x, install("stop"));
+    hasStop = stop != R_NilValue && asLogical(stop) == TRUE;
+    w->size = 0;
+    writeBytes(w, HEADER, sizeof(HEADER));
+    writeInt(w, VEC_TYPE | (names != R_NilValue || hasStop ? HAS_ATTR : 0));
+    writeInt(w, n);
+    for(i = 0; i < n; ++i)
+    {
+        writeColumn(w, VECTOR_ELT(x, i), i);
+    }
+    if(names != R_NilValue)
+    {
+        writeInt(w, LIST_TYPE | HAS_TAG);
+        writeSymbol(w, "names");
+        writeStrings(w, names);
+    }
+    if(hasStop)
+    {
+        writeInt(w, LIST_TYPE | HAS_TAG);
+        writeSymbol(w, "stop");
+        writeInt(w, LGL_TYPE);
+        writeInt(w, 1);
+        writeInt(w, 1);
+    }
+    if(names != R_NilValue || hasStop)
+    {
+        writeInt(w, NILVALUE_TYPE);
+    }
+}
+
+SEXP scidbstrm_read_df(void)
+{
+    return readDataFrame(&stdinReader);
+}
+
+SEXP scidbstrm_write_df(SEXP x)
+{
+    size_t written = 0;
+    writeDataFrame(&stdoutWriter, x);
+    while(written < stdoutWriter.size)
+    {
+        ssize_t ret = write(STDOUT_FILENO, stdoutWriter.data + written, stdoutWriter.size - written);
+        if(ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(ret <= 0)
+        {
+            error("scidbstrm: could not write to SciDB");
+        }
+        written += ret;
+    }
+    return R_NilValue;
+}
+
+SEXP scidbstrm_decode_df(SEXP message)
+{
+    reader_t r;
+    if(TYPEOF(message) != RAWSXP)
+    {
+        error("scidbstrm: expected a raw vector");
+    }
+    memset(&r, 0, sizeof(r));
+    r.data = RAW(message);
+    r.end = XLENGTH(message);
+    r.cap = r.end;
+    r.fd = -1;
+    return readDataFrame(&r);
+}
+
+SEXP scidbstrm_encode_df(SEXP x)
+{
+    writeDataFrame(&stdoutWriter, x);
+    SEXP message = PROTECT(allocVector(RAWSXP, stdoutWriter.size));
+    memcpy(RAW(message), stdoutWriter.data, stdoutWriter.size);
+    UNPROTECT(1);
+    return message;
+}
+
+static const R_CallMethodDef callMethods[] =
+{
+    { "C_scidbstrm_read_df",   (DL_FUNC) &scidbstrm_read_df,   0 },
+    { "C_scidbstrm_write_df",  (DL_FUNC) &scidbstrm_write_df,  1 },
+    { "C_scidbstrm_decode_df", (DL_FUNC) &scidbstrm_decode_df, 1 },
+    { "C_scidbstrm_encode_df", (DL_FUNC) &scidbstrm_encode_df, 1 },
+    { NULL, NULL, 0 }
+};
+
+void R_init_scidbstrm(DllInfo* dll)
+{
+    R_registerRoutines(dll, NULL, callMethods, NULL, NULL);
+    R_useDynamicSymbols(dll, FALSE);
+    R_forceSymbols(dll, TRUE);
+}
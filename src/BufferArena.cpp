@@ -0,0 +1,167 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "BufferArena.h"
+#include <stdlib.h>
+#include <system/Config.h>
+
+using std::vector;
+
+namespace scidb { namespace stream {
+
+void BufferArena::Buffer::reserve(size_t capacity)
+{
+    if(capacity <= _capacity && _data)
+    {
+        return;
+    }
+    size_t newCapacity;
+    size_t const minCapacity = _data ? _capacity + _capacity / 2 : 0;
+    char* newData = _arena->allocate(std::max(std::max(capacity, _size), minCapacity), newCapacity);
+    if(_size)
+    {
+        memcpy(newData, _data, _size);
+    }
+    if(_data)
+    {
+        _arena->deallocate(_data, _capacity);
+    }
+    _data = newData;
+    _capacity = newCapacity;
+}
+
+void BufferArena::Buffer::release()
+{
+    if(_data)
+    {
+        _arena->deallocate(_data, _capacity);
+        _data = NULL;
+    }
+    _size = 0;
+    _capacity = 0;
+}
+
+BufferArena::BufferArena(size_t maxBytes):
+    _maxBytes(maxBytes),
+    _heldBytes(0),
+    _inUseBytes(0),
+    _highWater(0)
+{
+    size_t capacity;
+    _freeLists.resize(getSizeClass(MAX_POOLED_BYTES, capacity) + 1);
+}
+
+BufferArena::~BufferArena()
+{
+    dropFreeLists();
+    // every buffer should have been returned by now; any bytes still in use belong to a buffer that outlives the arena
+    LOG4CXX_INFO(logger, "stream buffer arena high-water mark "<<_highWater<<" bytes of "<<_maxBytes<<", "<<_inUseBytes<<" bytes still in use");
+}
+
+size_t BufferArena::getMemoryLimit()
+{
+    return Config::getInstance()->getOption<size_t>(CONFIG_MEM_ARRAY_THRESHOLD) * 1024 * 1024;
+}
+
+size_t BufferArena::getSizeClass(size_t bytes, size_t& capacity)
+{
+    size_t sizeClass = 0;
+    capacity = MIN_POOLED_BYTES;
+    while(capacity < bytes)
+    {
+        capacity *= 2;
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+char* BufferArena::allocate(size_t bytes, size_t& capacity)
+{
+    size_t sizeClass = 0;
+    if(bytes > MAX_POOLED_BYTES)
+    {
+        size_t const MB = 1024*1024;
+        capacity = (bytes + MB - 1) / MB * MB;
+    }
+    else
+    {
+        sizeClass = getSizeClass(bytes, capacity);
+        vector<char*>& freeList = _freeLists[sizeClass];
+        if(!freeList.empty())
+        {
+            char* data = freeList.back();
+            freeList.pop_back();
+            _inUseBytes += capacity;
+            return data;
+        }
+    }
+    if(_heldBytes + capacity > _maxBytes)
+    {
+        dropFreeLists();
+        if(_heldBytes + capacity > _maxBytes)
+        {
+            LOG4CXX_DEBUG(logger, "stream buffers exceed the arena limit of "<<_maxBytes<<" bytes (mem-array-threshold),"
+                          <<" allocating "<<capacity<<" bytes outside the pool");
+        }
+    }
+    void* data = NULL;
+    if(posix_memalign(&data, ALIGNMENT, capacity) != 0)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "stream could not allocate a buffer";
+    }
+    _heldBytes += capacity;
+    _inUseBytes += capacity;
+    _highWater = std::max(_highWater, _heldBytes);
+    return (char*) data;
+}
+
+void BufferArena::deallocate(char* data, size_t capacity)
+{
+    _inUseBytes -= capacity;
+    if(capacity > MAX_POOLED_BYTES || _heldBytes > _maxBytes)
+    {
+        // large buffers, and any buffer while the arena is over its cap, go straight back to the system
+        free(data);
+        _heldBytes -= capacity;
+        return;
+    }
+    size_t pooledCapacity;
+    _freeLists[getSizeClass(capacity, pooledCapacity)].push_back(data);
+}
+
+void BufferArena::dropFreeLists()
+{
+    for(size_t i = 0; i<_freeLists.size(); ++i)
+    {
+        for(char* data : _freeLists[i])
+        {
+            free(data);
+            _heldBytes -= MIN_POOLED_BYTES << i;
+        }
+        _freeLists[i].clear();
+    }
+}
+
+}}
@@ -0,0 +1,246 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_BUFFERARENA_H_
+#define SRC_BUFFERARENA_H_
+
+#include <query/PhysicalOperator.h>
+
+namespace scidb { namespace stream
+{
+
+/**
+ * A pool of byte buffers owned by one stream session, from which the interfaces draw their conversion and framing
+ * buffers instead of allocating fresh ones per message. Buffers up to MAX_POOLED_BYTES come in power-of-two size
+ * classes and go back to a free list when released; larger buffers are rounded up to a megabyte and freed on
+ * release. A buffer that grows takes at least one and a half times its capacity, so that appending to it costs
+ * amortized constant time at any size. The memory kept by the arena is capped: when a new block would exceed the
+ * cap the free lists are dropped first, and if that is not enough the block is allocated anyway but freed, not
+ * pooled, on release, until the arena is back under its cap. The arena logs its high-water mark when it is
+ * destroyed. Every buffer starts on an ALIGNMENT boundary, so that Arrow can use the data read into it in place.
+ */
+class BufferArena
+{
+public:
+    static size_t const MIN_POOLED_BYTES = 4096;
+    static size_t const MAX_POOLED_BYTES = 64*1024*1024;
+    static size_t const ALIGNMENT = 64;
+
+    /**
+     * A buffer drawn from an arena, returned to it on destruction. Move-only. Behaves like a vector<char> that only
+     * grows its capacity.
+     */
+    class Buffer
+    {
+    public:
+        Buffer():
+            _arena(NULL),
+            _data(NULL),
+            _size(0),
+            _capacity(0)
+        {}
+
+        Buffer(BufferArena& arena, size_t capacity):
+            _arena(&arena),
+            _data(NULL),
+            _size(0),
+            _capacity(0)
+        {
+            reserve(capacity);
+        }
+
+        Buffer(Buffer&& other):
+            _arena(other._arena),
+            _data(other._data),
+            _size(other._size),
+            _capacity(other._capacity)
+        {
+            other._data = NULL;
+            other._size = 0;
+            other._capacity = 0;
+        }
+
+        Buffer& operator=(Buffer&& other)
+        {
+            if(this != &other)
+            {
+                release();
+                _arena = other._arena;
+                _data = other._data;
+                _size = other._size;
+                _capacity = other._capacity;
+                other._data = NULL;
+                other._size = 0;
+                other._capacity = 0;
+            }
+            return *this;
+        }
+
+        Buffer(Buffer const&) = delete;
+        Buffer& operator=(Buffer const&) = delete;
+
+        ~Buffer()
+        {
+            release();
+        }
+
+        char* data()
+        {
+            return _data;
+        }
+
+        char const* data() const
+        {
+            return _data;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        size_t capacity() const
+        {
+            return _capacity;
+        }
+
+        char& operator[](size_t i)
+        {
+            return _data[i];
+        }
+
+        /**
+         * Make room for at least capacity bytes, keeping the contents; a buffer that has to grow takes at least one
+         * and a half times its capacity.
+         */
+        void reserve(size_t capacity);
+
+        void resize(size_t size)
+        {
+            if(size > _capacity)
+            {
+                reserve(size);
+            }
+            _size = size;
+        }
+
+        void append(void const* data, size_t bytes)
+        {
+            if(_size + bytes > _capacity)
+            {
+                reserve(_size + bytes);
+            }
+            memcpy(_data + _size, data, bytes);
+            _size += bytes;
+        }
+
+        void append(char c)
+        {
+            if(_size == _capacity)
+            {
+                reserve(_size + 1);
+            }
+            _data[_size++] = c;
+        }
+
+        /**
+         * Make room for up to maxBytes more bytes and return where they go; commitAppend then adds the bytes that
+         * were actually written.
+         */
+        char* prepareAppend(size_t maxBytes)
+        {
+            if(_size + maxBytes > _capacity)
+            {
+                reserve(_size + maxBytes);
+            }
+            return _data + _size;
+        }
+
+        void commitAppend(size_t bytes)
+        {
+            _size += bytes;
+        }
+
+        void clear()
+        {
+            _size = 0;
+        }
+
+        /**
+         * Give the memory back to the arena; the buffer is empty afterwards.
+         */
+        void release();
+
+    private:
+        BufferArena* _arena;
+        char*        _data;
+        size_t       _size;
+        size_t       _capacity;
+    };
+
+    /**
+     * @param maxBytes the cap on the memory kept by the arena
+     */
+    explicit BufferArena(size_t maxBytes = getMemoryLimit());
+
+    ~BufferArena();
+
+    BufferArena(BufferArena const&) = delete;
+    BufferArena& operator=(BufferArena const&) = delete;
+
+    /**
+     * @return an empty buffer with room for at least capacity bytes
+     */
+    Buffer acquire(size_t capacity)
+    {
+        return Buffer(*this, capacity);
+    }
+
+    /**
+     * @return the default cap: the mem-array-threshold of the SciDB configuration
+     */
+    static size_t getMemoryLimit();
+
+    size_t getHighWaterMark() const
+    {
+        return _highWater;
+    }
+
+private:
+    size_t                            _maxBytes;
+    size_t                            _heldBytes;
+    size_t                            _inUseBytes;
+    size_t                            _highWater;
+    std::vector<std::vector<char*> >  _freeLists;
+
+    static size_t getSizeClass(size_t bytes, size_t& capacity);
+    char* allocate(size_t bytes, size_t& capacity);
+    void  deallocate(char* data, size_t capacity);
+    void  dropFreeLists();
+};
+
+}}
+
+#endif /* SRC_BUFFERARENA_H_ */
@@ -36,25 +36,41 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <algorithm>
 #include <query/Query.h>
 
 using std::shared_ptr;
 using std::string;
+using std::vector;
 
 namespace scidb { namespace stream
 {
 
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.operators.stream.childprocess"));
 
-ChildProcess::ChildProcess(string const& commandLine, shared_ptr<Query>& query, size_t const readBufSize):
+ChildProcess::ChildProcess(string const& commandLine,
+                           shared_ptr<Query>& query,
+                           vector<string> const& environment,
+                           size_t const readBufSize):
         _alive(false),
         _pollTimeoutMillis(100),
         _query(query),
         _readBuf(readBufSize),
         _readBufIdx(0),
-        _readBufEnd(0)
+        _readBufEnd(0),
+        _recording(NULL),
+        _replayIdx(0)
 {
     LOG4CXX_DEBUG(logger, "Executing "<<commandLine);
+    //build the environment before forking; the child should not allocate
+    vector<char*> envp;
+    for(size_t i = 0; i<environment.size(); ++i)
+    {
+        envp.push_back(const_cast<char*>(environment[i].c_str()));
+    }
+    envp.push_back(NULL);
     int parent_child[2];          // pipe descriptors parent writes to child
     int child_parent[2];          // pipe descriptors child writes to parent
     pipe (parent_child);
@@ -79,7 +95,7 @@ ChildProcess::ChildProcess(string const& commandLine, shared_ptr<Query>& query,
         {
             close(i);
         }
-        execle ("/bin/bash", "/bin/bash", "-c", commandLine.c_str(), NULL, NULL);
+        execle ("/bin/bash", "/bin/bash", "-c", commandLine.c_str(), NULL, &envp[0]);
         abort ();  //if execle returns, it means we're in trouble. bail asap.
         break;
     default:  // parent
@@ -129,9 +145,17 @@ void ChildProcess::terminate()
 
 void ChildProcess::readIntoBuf(bool throwIfChildDead)
 {
-    _readBufIdx = 0;
-    _readBufEnd = 0;
+    if(_readBufIdx == _readBufEnd)
+    {
+        _readBufIdx = 0;
+        _readBufEnd = 0;
+    }
     LOG4CXX_TRACE(logger, "read into buf from child");
+    _readBufEnd += readFromChild(&_readBuf[_readBufEnd], _readBuf.size() - _readBufEnd, throwIfChildDead);
+}
+
+size_t ChildProcess::readFromChild(char* dest, size_t const maxBytes, bool throwIfChildDead)
+{
     if(!isAlive())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: attempt to read froom dead child";
@@ -163,7 +187,7 @@ void ChildProcess::readIntoBuf(bool throwIfChildDead)
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "poll failed";
     }
     errno = 0;
-    ssize_t nRead = read(_childOutFd, &_readBuf[0], _readBuf.size());
+    ssize_t nRead = read(_childOutFd, dest, maxBytes);
     if(nRead <= 0)
     {
         LOG4CXX_WARN(logger, "STREAM: child terminated early: read returned "<<nRead <<" errno "<<errno);
@@ -171,19 +195,84 @@ void ChildProcess::readIntoBuf(bool throwIfChildDead)
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "error reading from child";
     }
     LOG4CXX_TRACE(logger, "Read "<<nRead<<" bytes from child");
-    _readBufEnd = nRead;
+    return nRead;
+}
+
+char* ChildProcess::peek(size_t const minBytes, size_t& available, bool throwIfChildDead)
+{
+    if(_replayIdx < _replay.size())
+    {
+        available = _replay.size() - _replayIdx;
+        if(available < minBytes)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "replayed response is truncated";
+        }
+        return &_replay[_replayIdx];
+    }
+    if(_readBufEnd - _readBufIdx < minBytes)
+    {
+        if(minBytes > _readBuf.size())
+        {
+            _readBuf.resize(minBytes);
+        }
+        if(_readBufIdx + minBytes > _readBuf.size())
+        {
+            // move what is left to the front to make room behind it
+            memmove(&_readBuf[0], &_readBuf[_readBufIdx], _readBufEnd - _readBufIdx);
+            _readBufEnd -= _readBufIdx;
+            _readBufIdx = 0;
+        }
+        while(_readBufEnd - _readBufIdx < minBytes)
+        {
+            readIntoBuf(throwIfChildDead);
+        }
+    }
+    available = _readBufEnd - _readBufIdx;
+    return &_readBuf[_readBufIdx];
+}
+
+void ChildProcess::skip(size_t const bytes)
+{
+    if(_replayIdx < _replay.size())
+    {
+        _replayIdx += bytes;
+        return;
+    }
+    if(_recording)
+    {
+        _recording->insert(_recording->end(), &_readBuf[_readBufIdx], &_readBuf[_readBufIdx] + bytes);
+    }
+    _readBufIdx += bytes;
 }
 
 void ChildProcess::hardWrite(void const* buf, size_t const bytes)
+{
+    struct iovec segment;
+    segment.iov_base = const_cast<void*>(buf);
+    segment.iov_len = bytes;
+    hardWritev(&segment, 1);
+}
+
+void ChildProcess::hardWritev(struct iovec const* segments, size_t const count)
 {
     if(!isAlive())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: attempt to write to dead child";
     }
     LOG4CXX_TRACE(logger, "Writing to child");
+    _pendingWrite.assign(segments, segments + count);
+    size_t first = 0;
     size_t bytesWritten = 0;
-    while(bytesWritten != bytes)
+    while(true)
     {
+        while(first < _pendingWrite.size() && _pendingWrite[first].iov_len == 0)
+        {
+            ++first;
+        }
+        if(first == _pendingWrite.size())
+        {
+            break;
+        }
         struct pollfd pollstat [1];
         pollstat[0].fd = _childInFd;
         pollstat[0].events = POLLOUT;
@@ -211,7 +300,8 @@ void ChildProcess::hardWrite(void const* buf, size_t const bytes)
             throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "poll failed";
         }
         errno = 0;
-        size_t writeRet = write(_childInFd, ((char const *)buf) + bytesWritten, bytes - bytesWritten);
+        size_t const nSegments = std::min<size_t>(_pendingWrite.size() - first, IOV_MAX);
+        ssize_t writeRet = writev(_childInFd, &_pendingWrite[first], nSegments);
         if(writeRet <= 0)
         {
             LOG4CXX_WARN(logger, "STREAM: child terminated early: write returned "<<writeRet <<" errno "<<errno);
@@ -219,9 +309,21 @@ void ChildProcess::hardWrite(void const* buf, size_t const bytes)
             throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "error writing to child";
         }
         bytesWritten += writeRet;
+        // skip the segments written in full and advance into the one written in part, if any
+        size_t remaining = writeRet;
+        while(remaining > 0 && remaining >= _pendingWrite[first].iov_len)
+        {
+            remaining -= _pendingWrite[first].iov_len;
+            ++first;
+        }
+        if(remaining > 0)
+        {
+            _pendingWrite[first].iov_base = ((char*) _pendingWrite[first].iov_base) + remaining;
+            _pendingWrite[first].iov_len -= remaining;
+        }
         LOG4CXX_TRACE(logger, "Write iteration");
     }
-    LOG4CXX_TRACE(logger, "Wrote "<<bytes<<" bytes to child");
+    LOG4CXX_TRACE(logger, "Wrote "<<bytesWritten<<" bytes to child");
 }
 
 }} //namespaces
@@ -28,6 +28,7 @@
 
 #include <query/PhysicalOperator.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 namespace scidb { namespace stream
 {
@@ -42,9 +43,13 @@ public:
      * Fork a new process.
      * @param commandLine the bash command to execute
      * @param query the query context
+     * @param environment NAME=value strings making up the environment of the child; empty by default
      * @param readBufSize the size of the buffer used for reading
      */
-    ChildProcess(std::string const& commandLine, std::shared_ptr<Query>& query, size_t const readBufSize = 1024*1024);
+    ChildProcess(std::string const& commandLine,
+                 std::shared_ptr<Query>& query,
+                 std::vector<std::string> const& environment = std::vector<std::string>(),
+                 size_t const readBufSize = 1024*1024);
     ~ChildProcess()
     {
         terminate();
@@ -77,13 +82,35 @@ public:
      */
     size_t softRead(void* outputBuf, size_t const maxBytes, bool throwIfChildDead = true)
     {
+        if(_replayIdx < _replay.size())
+        {
+            size_t bytesToReturn = _replay.size() - _replayIdx;
+            bytesToReturn = maxBytes < bytesToReturn ? maxBytes : bytesToReturn;
+            memcpy(outputBuf, &_replay[_replayIdx], bytesToReturn);
+            _replayIdx += bytesToReturn;
+            return bytesToReturn;
+        }
         if(_readBufIdx == _readBufEnd)
         {
+            if(maxBytes >= _readBuf.size())
+            {
+                // a large read goes straight from the pipe to its destination
+                size_t const bytesRead = readFromChild((char*) outputBuf, maxBytes, throwIfChildDead);
+                if(_recording)
+                {
+                    _recording->insert(_recording->end(), (char*) outputBuf, (char*) outputBuf + bytesRead);
+                }
+                return bytesRead;
+            }
             readIntoBuf(throwIfChildDead);
         }
         size_t bytesToReturn = _readBufEnd - _readBufIdx;
         bytesToReturn = maxBytes < bytesToReturn ? maxBytes : bytesToReturn;
         memcpy(outputBuf, &_readBuf[_readBufIdx], bytesToReturn);
+        if(_recording)
+        {
+            _recording->insert(_recording->end(), &_readBuf[_readBufIdx], &_readBuf[_readBufIdx] + bytesToReturn);
+        }
         _readBufIdx += bytesToReturn;
         return bytesToReturn;
     }
@@ -106,6 +133,23 @@ public:
         }
     }
 
+    /**
+     * Make at least minBytes of the data from child readable in place, without copying it out. The data may be
+     * consumed in part with skip; the rest is returned by the following reads. The caller may change the bytes it
+     * has not skipped yet, as long as it restores them before skipping them.
+     * @param minBytes the number of bytes needed
+     * @param available set to the number of bytes readable at the returned address, at least minBytes
+     * @param throwIfChildDead check that the child process is running and throw if it is not running.
+     * @return the address of the next unread byte
+     * @throw if the query was cancelled while reading, or child has exited, or there was a read error
+     */
+    char* peek(size_t const minBytes, size_t& available, bool throwIfChildDead = true);
+
+    /**
+     * Consume bytes returned by a previous peek call.
+     */
+    void skip(size_t const bytes);
+
     /**
      * Write exactly [bytes] of data from buf to child. Returns only after successful write. The writes
      * are *NOT* buffered - so the caller should coalesce data into large chunks before writing.
@@ -115,6 +159,40 @@ public:
      */
     void hardWrite(void const* inputBuf, size_t const bytes);
 
+    /**
+     * Write exactly the given segments, in order, to child with as few writev calls as the pipe allows. Returns only
+     * after successful write.
+     * @param segments the data to write
+     * @param count the number of segments
+     * @throw if the query was cancelled while writing, or child has exited or there was a write error
+     */
+    void hardWritev(struct iovec const* segments, size_t const count);
+
+    /**
+     * Append all the bytes subsequently read from the child to response, until stopRecording is called.
+     * @param response the destination; must outlive the recording
+     */
+    void startRecording(std::vector<char>* response)
+    {
+        _recording = response;
+    }
+
+    void stopRecording()
+    {
+        _recording = NULL;
+    }
+
+    /**
+     * Serve the following reads from a previously recorded response, as if the child had written it. Reads
+     * return to the child once the response is consumed.
+     * @param response the bytes to read; copied
+     */
+    void replay(std::vector<char> const& response)
+    {
+        _replay = response;
+        _replayIdx = 0;
+    }
+
 private:
     bool  _alive;
     int const _pollTimeoutMillis;
@@ -125,8 +203,48 @@ private:
     pid_t _childPid;
     int   _childInFd;
     int   _childOutFd;
+    std::vector<char>* _recording;
+    std::vector<char>  _replay;
+    size_t _replayIdx;
+    std::vector<struct iovec> _pendingWrite;
 
     void readIntoBuf(bool throwIfChildDead);
+    size_t readFromChild(char* dest, size_t const maxBytes, bool throwIfChildDead);
+};
+
+/**
+ * Collects the bytes that an interface would write to the child, so that a message can be encoded without a child
+ * process and sent or stored later. Has the same hardWrite signature as ChildProcess.
+ */
+class MessageRecorder
+{
+public:
+    void hardWrite(void const* inputBuf, size_t const bytes)
+    {
+        char const* data = (char const*) inputBuf;
+        _data.insert(_data.end(), data, data + bytes);
+    }
+
+    void hardWritev(struct iovec const* segments, size_t const count)
+    {
+        for(size_t i = 0; i<count; ++i)
+        {
+            hardWrite(segments[i].iov_base, segments[i].iov_len);
+        }
+    }
+
+    std::vector<char> const& data() const
+    {
+        return _data;
+    }
+
+    void clear()
+    {
+        _data.clear();
+    }
+
+private:
+    std::vector<char> _data;
 };
 
 } } //namespace
@@ -26,8 +26,12 @@
 #include "DFInterface.h"
 #include "StreamSettings.h"
 #include "ChildProcess.h"
+#include "Sampler.h"
+#include "NAKernels.h"
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <query/Query.h>
 #include <array/MemArray.h>
 
@@ -37,6 +41,162 @@ using std::string;
 
 namespace scidb { namespace stream {
 
+static const unsigned char R_HEADER[14]    = { 0x42, 0x0a, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x00, 0x00, 0x03, 0x02, 0x00 };
+static const unsigned char R_EVECSXP[4]    = { 0x13, 0x00, 0x00, 0x00 };     // R list without attributes
+static const unsigned char R_VECSXP[4]     = { 0x13, 0x02, 0x00, 0x00 };     // R list with attributes
+static const unsigned char R_INTSXP[4]     = { 0x0d, 0x00, 0x00, 0x00 };
+static const unsigned char R_REALSXP[4]    = { 0x0e, 0x00, 0x00, 0x00 };
+static const unsigned char R_CHARSXP[4]    = { 0x09, 0x00, 0x04, 0x00 };    // UTF-8
+static const unsigned char R_STRSXP[4]     = { 0x10, 0x00, 0x00, 0x00 };
+static const unsigned char R_LISTSXP[4]    = { 0x02, 0x04, 0x00, 0x00 };    // internal R pairlist
+static const unsigned char R_TAIL_HDR[21]  = { 0x02, 0x04, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x09, 0x00, 0x04, 0x00, 0x05, 0x00, 0x00, 0x00, 0x6e, 0x61, 0x6d, 0x65, 0x73 };
+static const unsigned char R_TAIL[4]       = { 0xfe, 0x00, 0x00, 0x00 };
+
+// R serialization item types and flags, for the attributes of a response
+static const int32_t R_TYPE_MASK    = 0xff;
+static const int32_t R_IS_OBJECT    = 0x100;
+static const int32_t R_HAS_ATTR     = 0x200;
+static const int32_t R_HAS_TAG      = 0x400;
+static const int32_t R_SYMSXP_TYPE  = 1;
+static const int32_t R_LISTSXP_TYPE = 2;
+static const int32_t R_CHARSXP_TYPE = 9;
+static const int32_t R_LGLSXP_TYPE  = 10;
+static const int32_t R_INTSXP_TYPE  = 13;
+static const int32_t R_REALSXP_TYPE = 14;
+static const int32_t R_STRSXP_TYPE  = 16;
+static const int32_t R_NILVALUE_TYPE = 254;
+static const int32_t R_REFSXP_TYPE  = 255;
+
+template <>
+int32_t DFInterface::rNA<int32_t>() const
+{
+    return _rNanInt32;
+}
+
+template <>
+int64_t DFInterface::rNA<int64_t>() const
+{
+    return std::numeric_limits<int64_t>::min();     // NA_integer64 of bit64
+}
+
+template <>
+double DFInterface::rNA<double>() const
+{
+    return _rNanDouble;
+}
+
+static void appendRChars(string& out, string const& chars)
+{
+    out.append((char const*) R_CHARSXP, sizeof(R_CHARSXP));
+    int32_t size = chars.size();
+    out.append((char const*) &size, sizeof(int32_t));
+    out.append(chars);
+}
+
+/**
+ * Serialize a tagged string attribute, like class, as an element of the attribute pairlist of an R vector.
+ */
+static void appendRAttribute(string& out, char const* tag, vector<string> const& values)
+{
+    out.append((char const*) R_LISTSXP, sizeof(R_LISTSXP));
+    int32_t const symbol = R_SYMSXP_TYPE;
+    out.append((char const*) &symbol, sizeof(int32_t));
+    appendRChars(out, tag);
+    out.append((char const*) R_STRSXP, sizeof(R_STRSXP));
+    int32_t length = values.size();
+    out.append((char const*) &length, sizeof(int32_t));
+    for(size_t i = 0; i<values.size(); ++i)
+    {
+        appendRChars(out, values[i]);
+    }
+}
+
+template <typename SCIDB_T, typename R_T>
+void DFInterface::writeNumericColumn(ConstChunkIterator& citer, int32_t const numRows)
+{
+    R_T* data = (R_T*) _writeBuf.prepareAppend(numRows * sizeof(R_T));
+    _naMask.resize(numRows);
+    size_t nNulls = 0;
+    int32_t row = 0;
+    for(size_t cell = 0; !citer.end() && row < numRows; ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& v = citer.getItem();
+        bool const isNull = v.isNull();
+        _naMask[row] = isNull;
+        nNulls += isNull;
+        data[row++] = isNull ? R_T() : static_cast<R_T>(v.get<SCIDB_T>());
+    }
+    if(nNulls)
+    {
+        NAKernels::fillNA(data, row, rNA<R_T>(), &_naMask[0]);
+    }
+    _writeBuf.commitAppend(row * sizeof(R_T));
+}
+
+void DFInterface::writeStringColumn(ConstChunkIterator& citer, int32_t const)
+{
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& v = citer.getItem();
+        _writeBuf.append(&R_CHARSXP, sizeof(R_CHARSXP));
+        if(v.isNull())
+        {
+            int32_t size = -1;
+            _writeBuf.append(&size, sizeof(int32_t));
+        }
+        else
+        {
+            int32_t size = v.size() - 1;
+            _writeBuf.append(&size, sizeof(int32_t));
+            _writeBuf.append(v.getString(), size);
+        }
+    }
+}
+
+void DFInterface::writeFactorColumn(ConstChunkIterator& citer, int32_t const numRows)
+{
+    // 1-based codes into the levels, in the order the strings first appear in the chunk, then the levels and the
+    // class of the factor as the attributes of the column
+    int32_t* data = (int32_t*) _writeBuf.prepareAppend(numRows * sizeof(int32_t));
+    _factorCodes.clear();
+    _factorLevels.clear();
+    int32_t row = 0;
+    for(size_t cell = 0; !citer.end() && row < numRows; ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& v = citer.getItem();
+        if(v.isNull())
+        {
+            data[row++] = _rNanInt32;
+            continue;
+        }
+        _factorKey.assign(v.getString(), v.size() - 1);
+        auto code = _factorCodes.find(_factorKey);
+        if(code == _factorCodes.end())
+        {
+            _factorLevels.push_back(_factorKey);
+            code = _factorCodes.insert(std::make_pair(_factorKey, (int32_t) _factorLevels.size())).first;
+        }
+        data[row++] = code->second;
+    }
+    _writeBuf.commitAppend(row * sizeof(int32_t));
+    _factorAttributes.clear();
+    appendRAttribute(_factorAttributes, "levels", _factorLevels);
+    appendRAttribute(_factorAttributes, "class", vector<string>(1, "factor"));
+    _factorAttributes.append((char const*) R_TAIL, sizeof(R_TAIL));
+}
+
 ArrayDesc DFInterface::getOutputSchema(std::vector<ArrayDesc> const& inputSchemas, Settings const& settings, std::shared_ptr<Query> const& query)
 {
     if(settings.getFormat() != DF)
@@ -71,10 +231,12 @@ ArrayDesc DFInterface::getOutputSchema(std::vector<ArrayDesc> const& inputSchema
         {
 //            AttributeDesc const& attr = attrs[j];
             TypeEnum te = typeId2TypeEnum(attr.getType(), true);
-            if(te != TE_UINT16 &&  te != TE_INT32 && te != TE_DOUBLE && te != TE_STRING)
+            if(te != TE_BOOL && te != TE_INT8 && te != TE_INT16 && te != TE_INT32 && te != TE_INT64 &&
+               te != TE_UINT8 && te != TE_UINT16 && te != TE_UINT32 && te != TE_UINT64 &&
+               te != TE_FLOAT && te != TE_DOUBLE && te != TE_STRING && te != TE_DATETIME)
             {
                 ostringstream error;
-                error<<"Attribute "<<attr.getName()<<" has unsupported type "<<attr.getType()<<" only double, uint16, int32 and string supported right now";
+                error<<"Attribute "<<attr.getName()<<" has unsupported type "<<attr.getType()<<"; only numeric, bool, string and datetime attributes are supported";
                 throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
             }
         }
@@ -86,13 +248,23 @@ ArrayDesc DFInterface::getOutputSchema(std::vector<ArrayDesc> const& inputSchema
     Attributes outputAttributes;
     for(AttributeID i =0; i<outputTypes.size(); ++i)
     {
+        if(outputTypes[i] == TE_BINARY)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "DF interface does not support binary output";
+        }
+        if(outputTypes[i] != TE_BOOL && outputTypes[i] != TE_INT32 && outputTypes[i] != TE_INT64 && outputTypes[i] != TE_FLOAT &&
+           outputTypes[i] != TE_DOUBLE && outputTypes[i] != TE_DATETIME && outputTypes[i] != TE_STRING)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "DF interface supports only bool, int32, int64, float, double, datetime and string output";
+        }
         outputAttributes.push_back( AttributeDesc(outputNames[i], typeEnum2TypeId(outputTypes[i]), AttributeDesc::IS_NULLABLE, CompressorType::NONE));
     }
     outputAttributes.addEmptyTagAttribute();
     return ArrayDesc(inputSchemas[0].getName(), outputAttributes, outputDimensions, createDistribution(dtUndefined), query->getDefaultArrayResidency());
 }
 
-DFInterface::DFInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query):
+DFInterface::DFInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query,
+                         BufferArena& arena):
     _query(query),
     _result(new MemArray(outputSchema, query)),
     _outPos{ ((Coordinate) query->getInstanceID()), 0, 0 },
@@ -100,8 +272,13 @@ DFInterface::DFInterface(Settings const& settings, ArrayDesc const& outputSchema
     _nOutputAttrs( (int32_t) outputSchema.getAttributes(true).size()),
     _oaiters(_nOutputAttrs+1),
     _outputTypes(_nOutputAttrs),
-    _readBuf(1024*1024),
-    _writeBuf(1024*1024)
+    _arena(arena),
+    _readBuf(arena.acquire(READ_BUF_SIZE)),
+    _writeBuf(arena.acquire(1024*1024)),
+    _sampler(NULL),
+    _stopRequested(false),
+    _int64AsInteger64(settings.isInt64AsInteger64()),
+    _dictionaryEncoding(settings.getDictionaryEncoding())
 {
 //    for(int32_t i =0; i<_nOutputAttrs; ++i)
     int32_t i =0;
@@ -118,8 +295,9 @@ DFInterface::DFInterface(Settings const& settings, ArrayDesc const& outputSchema
     _rNanInt32  = std::numeric_limits<int32_t>::min();
 }
 
-void DFInterface::setInputSchema(ArrayDesc const& inputSchema)
+void DFInterface::setInputSchema(ArrayDesc const& inputSchema, Sampler const* sampler)
 {
+    _sampler = sampler;
     Attributes const& attrs = inputSchema.getAttributes(true);
     size_t const nInputAttrs = attrs.size();
     _inputTypes.resize(nInputAttrs);
@@ -132,28 +310,109 @@ void DFInterface::setInputSchema(ArrayDesc const& inputSchema)
         _inputNames[i]= attr.getName();
         i++;
     }
+    // pick the conversion kernel of every column once, rather than switching on the type of every cell
+    _columnWriters.resize(nInputAttrs);
+    _columnFlags.resize(nInputAttrs);
+    _columnAttributes.assign(nInputAttrs, string());
+    for(i=0; i<nInputAttrs; ++i)
+    {
+        int32_t const classed = R_REALSXP_TYPE | R_IS_OBJECT | R_HAS_ATTR;
+        switch(_inputTypes[i])
+        {
+        case TE_STRING:   _columnWriters[i] = &DFInterface::writeStringColumn;                      _columnFlags[i] = R_STRSXP_TYPE;  break;
+        case TE_BOOL:     _columnWriters[i] = &DFInterface::writeNumericColumn<bool, int32_t>;      _columnFlags[i] = R_LGLSXP_TYPE;  break;
+        case TE_INT8:     _columnWriters[i] = &DFInterface::writeNumericColumn<int8_t, int32_t>;    _columnFlags[i] = R_INTSXP_TYPE;  break;
+        case TE_INT16:    _columnWriters[i] = &DFInterface::writeNumericColumn<int16_t, int32_t>;   _columnFlags[i] = R_INTSXP_TYPE;  break;
+        case TE_INT32:    _columnWriters[i] = &DFInterface::writeNumericColumn<int32_t, int32_t>;   _columnFlags[i] = R_INTSXP_TYPE;  break;
+        case TE_UINT8:    _columnWriters[i] = &DFInterface::writeNumericColumn<uint8_t, int32_t>;   _columnFlags[i] = R_INTSXP_TYPE;  break;
+        case TE_UINT16:   _columnWriters[i] = &DFInterface::writeNumericColumn<uint16_t, int32_t>;  _columnFlags[i] = R_INTSXP_TYPE;  break;
+        case TE_UINT32:   _columnWriters[i] = &DFInterface::writeNumericColumn<uint32_t, double>;   _columnFlags[i] = R_REALSXP_TYPE; break;
+        case TE_UINT64:   _columnWriters[i] = &DFInterface::writeNumericColumn<uint64_t, double>;   _columnFlags[i] = R_REALSXP_TYPE; break;
+        case TE_FLOAT:    _columnWriters[i] = &DFInterface::writeNumericColumn<float, double>;      _columnFlags[i] = R_REALSXP_TYPE; break;
+        case TE_DOUBLE:   _columnWriters[i] = &DFInterface::writeNumericColumn<double, double>;     _columnFlags[i] = R_REALSXP_TYPE; break;
+        case TE_INT64:
+        {
+            if(_int64AsInteger64)
+            {
+                // the bits of the int64 in a double vector of class integer64, as the bit64 package keeps them
+                _columnWriters[i] = &DFInterface::writeNumericColumn<int64_t, int64_t>;
+                _columnFlags[i] = classed;
+                appendRAttribute(_columnAttributes[i], "class", vector<string>(1, "integer64"));
+                _columnAttributes[i].append((char const*) R_TAIL, sizeof(R_TAIL));
+            }
+            else
+            {
+                _columnWriters[i] = &DFInterface::writeNumericColumn<int64_t, double>;
+                _columnFlags[i] = R_REALSXP_TYPE;
+            }
+            break;
+        }
+        case TE_DATETIME:
+        {
+            // seconds since the epoch, as a POSIXct vector in UTC
+            _columnWriters[i] = &DFInterface::writeNumericColumn<int64_t, double>;
+            _columnFlags[i] = classed;
+            vector<string> classes;
+            classes.push_back("POSIXct");
+            classes.push_back("POSIXt");
+            appendRAttribute(_columnAttributes[i], "class", classes);
+            appendRAttribute(_columnAttributes[i], "tzone", vector<string>(1, "UTC"));
+            _columnAttributes[i].append((char const*) R_TAIL, sizeof(R_TAIL));
+            break;
+        }
+        default:          throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unsupported type";
+        }
+    }
 }
 
-void DFInterface::streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child)
+size_t DFInterface::checkInputChunks(std::vector<ConstChunk const*> const& inputChunks)
 {
     if(inputChunks.size() != _inputTypes.size())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "inconsistent input chunks given";
     }
-    size_t nRows = inputChunks[0]->count();
+    _mask.clear();
+    size_t nRows = _sampler ? _sampler->maskChunk(*inputChunks[0], _mask) : inputChunks[0]->count();
+    if(nRows > (size_t) std::numeric_limits<int32_t>::max())
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received chunk with count exceeding the R vector limit";
+    }
+    return nRows;
+}
+
+void DFInterface::streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child)
+{
+    size_t nRows = checkInputChunks(inputChunks);
     if(nRows == 0)
     {
         return;
     }
-    if(nRows > (size_t) std::numeric_limits<int32_t>::max())
+    if(!child.isAlive())
     {
-        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received chunk with count exceeding the R vector limit";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "child exited early";
+    }
+    writeDF(inputChunks, nRows, child);
+    readDF(child);
+}
+
+bool DFInterface::encodeData(std::vector<ConstChunk const*> const& inputChunks, MessageRecorder& recorder)
+{
+    size_t nRows = checkInputChunks(inputChunks);
+    if(nRows == 0)
+    {
+        return false;
     }
+    writeDF(inputChunks, nRows, recorder);
+    return true;
+}
+
+void DFInterface::streamEncoded(std::vector<char> const& message, ChildProcess& child)
+{
     if(!child.isAlive())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "child exited early";
     }
-    writeDF(inputChunks, nRows, child);
+    child.hardWrite(message.data(), message.size());
     readDF(child);
 }
 
@@ -165,127 +424,202 @@ shared_ptr<Array> DFInterface::finalize(ChildProcess& child)
     return _result;
 }
 
-static const unsigned char R_HEADER[14]    = { 0x42, 0x0a, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x00, 0x00, 0x03, 0x02, 0x00 };
-static const unsigned char R_EVECSXP[4]    = { 0x13, 0x00, 0x00, 0x00 };     // R list without attributes
-static const unsigned char R_VECSXP[4]     = { 0x13, 0x02, 0x00, 0x00 };     // R list with attributes
-static const unsigned char R_INTSXP[4]     = { 0x0d, 0x00, 0x00, 0x00 };
-static const unsigned char R_REALSXP[4]    = { 0x0e, 0x00, 0x00, 0x00 };
-static const unsigned char R_CHARSXP[4]    = { 0x09, 0x00, 0x04, 0x00 };    // UTF-8
-static const unsigned char R_STRSXP[4]     = { 0x10, 0x00, 0x00, 0x00 };
-static const unsigned char R_LISTSXP[4]    = { 0x02, 0x04, 0x00, 0x00 };    // internal R pairlist
-static const unsigned char R_TAIL_HDR[21]  = { 0x02, 0x04, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x09, 0x00, 0x04, 0x00, 0x05, 0x00, 0x00, 0x00, 0x6e, 0x61, 0x6d, 0x65, 0x73 };
-static const unsigned char R_TAIL[4]       = { 0xfe, 0x00, 0x00, 0x00 };
-
-void DFInterface::writeDF(vector<ConstChunk const*> const& chunks, int32_t const numRows, ChildProcess& child)
+template <class OUTPUT>
+void DFInterface::writeDF(vector<ConstChunk const*> const& chunks, int32_t const numRows, OUTPUT& out)
 {
-    child.hardWrite(R_HEADER, sizeof(R_HEADER));
-    child.hardWrite(R_VECSXP, sizeof(R_VECSXP));
+    // all the columns go to _writeBuf, one after the other, and the headers between them to the message builder
+    _writeBuf.clear();
+    _message.append(R_HEADER, sizeof(R_HEADER));
+    _message.append(R_VECSXP, sizeof(R_VECSXP));
     int32_t numColumns = chunks.size();
-    child.hardWrite(&numColumns, sizeof(int32_t));
+    _message.append(&numColumns, sizeof(int32_t));
     for(size_t i =0; i<_inputTypes.size(); ++i)
     {
-        switch(_inputTypes[i])
+        // a string column goes as a factor when the dictionary setting picks it for this chunk
+        bool const factor = _inputTypes[i] == TE_STRING && DictionaryProbe::useDictionary(_dictionaryEncoding, *chunks[i]);
+        int32_t const flags = factor ? R_INTSXP_TYPE | R_IS_OBJECT | R_HAS_ATTR : _columnFlags[i];
+        _message.append(&flags, sizeof(int32_t));
+        _message.append(&numRows, sizeof(int32_t));
+        shared_ptr<ConstChunkIterator> citer = chunks[i]->getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
+        size_t const start = (_writeBuf.size() + sizeof(double) - 1) & ~(sizeof(double) - 1);   // keep the column aligned
+        _writeBuf.resize(start);
+        if(factor)
         {
-        case TE_STRING:     child.hardWrite (R_STRSXP,  sizeof (R_STRSXP));  break;
-        case TE_DOUBLE:     child.hardWrite (R_REALSXP, sizeof (R_REALSXP)); break;
-        case TE_UINT16:
-        case TE_INT32:      child.hardWrite (R_INTSXP,  sizeof (R_INTSXP));  break;
-        default:         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unknown type";
+            writeFactorColumn(*citer, numRows);
         }
-        child.hardWrite(&numRows, sizeof(int32_t));
-        shared_ptr<ConstChunkIterator> citer = chunks[i]->getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
-        _writeBuf.reset();
-        while((!citer->end()))
+        else
+        {
+            (this->*_columnWriters[i])(*citer, numRows);
+        }
+        _message.appendRef(_writeBuf, start, _writeBuf.size() - start);
+        string const& attributes = factor ? _factorAttributes : _columnAttributes[i];
+        _message.append(attributes.data(), attributes.size());
+    }
+    _message.append(R_TAIL_HDR, sizeof(R_TAIL_HDR));
+    _message.append(R_STRSXP, sizeof(R_STRSXP));
+    _message.append(&numColumns, sizeof(int32_t));
+    for(size_t i =0; i<_inputTypes.size(); ++i)
+    {
+        _message.append(R_CHARSXP, sizeof(R_CHARSXP));
+        int32_t nameSize = _inputNames[i].size();
+        _message.append(&nameSize, sizeof(int32_t));
+        _message.append(_inputNames[i].c_str(), nameSize);
+    }
+    _message.append(R_TAIL, sizeof(R_TAIL));
+    _message.flush(out);
+}
+
+void DFInterface::writeFinalDF(ChildProcess& child)
+{
+    _message.append(R_HEADER,  sizeof(R_HEADER));
+    _message.append(R_EVECSXP, sizeof(R_VECSXP));
+    int32_t numColumns = 0;
+    _message.append(&numColumns, sizeof(int32_t));
+    _message.flush(child);
+}
+
+template <typename R_T, typename SCIDB_T>
+void DFInterface::storeNumericColumn(ChunkIterator& ociter, int32_t const numRows)
+{
+    R_T const* data = (R_T const*) _readBuf.data();
+    _naMask.resize(numRows);
+    // NaN has no integer, bool or datetime equivalent and becomes null along with NA
+    size_t const nNulls = NAKernels::findNA(data, numRows, rNA<R_T>(), !std::is_floating_point<SCIDB_T>::value, &_naMask[0]);
+    Coordinates valPos = _outPos;
+    for(int32_t j = 0; j<numRows; ++j)
+    {
+        ociter.setPosition(valPos);
+        if(nNulls && _naMask[j])
+        {
+            ociter.writeItem(_nullVal);
+        }
+        else
+        {
+            _val.set<SCIDB_T>(static_cast<SCIDB_T>(data[j]));
+            ociter.writeItem(_val);
+        }
+        ++valPos[2];
+    }
+}
+
+template <typename R_T>
+void DFInterface::readNumericColumn(TypeEnum const outputType, ChunkIterator& ociter, int32_t const numRows)
+{
+    switch(outputType)
+    {
+    case TE_BOOL:     storeNumericColumn<R_T, bool>(ociter, numRows);     break;
+    case TE_INT32:    storeNumericColumn<R_T, int32_t>(ociter, numRows);  break;
+    case TE_INT64:
+    case TE_DATETIME: storeNumericColumn<R_T, int64_t>(ociter, numRows);  break;
+    case TE_FLOAT:    storeNumericColumn<R_T, float>(ociter, numRows);    break;
+    case TE_DOUBLE:   storeNumericColumn<R_T, double>(ociter, numRows);   break;
+    default:          throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unknown type";
+    }
+}
+
+void DFInterface::storeFactorColumn(ChunkIterator& ociter, int32_t const numRows)
+{
+    // the levels were converted to values once, as they were read; every cell takes the value of its code
+    int32_t const* data = (int32_t const*) _readBuf.data();
+    int32_t const numLevels = _levels.size();
+    Coordinates valPos = _outPos;
+    for(int32_t j = 0; j<numRows; ++j)
+    {
+        ociter.setPosition(valPos);
+        if(data[j] == _rNanInt32)
+        {
+            ociter.writeItem(_nullVal);
+        }
+        else if(data[j] < 1 || data[j] > numLevels)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received a factor code out of range of its levels";
+        }
+        else
+        {
+            ociter.writeItem(_levels[data[j] - 1]);
+        }
+        ++valPos[2];
+    }
+}
+
+void DFInterface::readStringColumn(ChildProcess& child, bool lastMessage, ChunkIterator& ociter, int32_t const numRows)
+{
+    // parse the CHARSXP elements in place from the read buffer of the child, as many as it holds at a time, rather
+    // than reading the header and the bytes of every element separately. R does not share CHARSXPs through the
+    // reference table when serializing, and writes NA_STRING as length -1.
+    size_t const elementHeader = sizeof(R_CHARSXP) + sizeof(int32_t);
+    Coordinates valPos = _outPos;
+    int32_t j = 0;
+    while(j < numRows)
+    {
+        size_t available;
+        char* data = child.peek(elementHeader, available, !lastMessage);
+        size_t used = 0;
+        for(; j<numRows && available - used >= elementHeader; ++j)
         {
-            Value const& v = citer->getItem();
-            switch(_inputTypes[i])
+            int32_t flags;
+            int32_t size;
+            memcpy(&flags, data + used, sizeof(int32_t));
+            memcpy(&size, data + used + sizeof(int32_t), sizeof(int32_t));
+            if((flags & R_TYPE_MASK) != R_CHARSXP_TYPE || size < -1)
             {
-            case TE_STRING:
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "error reading string size";
+            }
+            if(size == -1)
             {
-                _writeBuf.pushData(&R_CHARSXP, sizeof(R_CHARSXP));
-                if(v.isNull())
-                {
-                    int32_t size = -1;
-                    _writeBuf.pushData(&size, sizeof(int32_t));
-                }
-                else
-                {
-                    int32_t size = v.size() - 1;
-                    _writeBuf.pushData(&size, sizeof(int32_t));
-                    _writeBuf.pushData(v.getString(), size);
-                }
-                break;
+                ociter.setPosition(valPos);
+                ociter.writeItem(_nullVal);
+                ++valPos[2];
+                used += elementHeader;
+                continue;
             }
-            case TE_DOUBLE:
+            if(available - used < elementHeader + size)
             {
-                if(v.isNull())
-                {
-                    _writeBuf.pushData(&_rNanDouble, sizeof(double));
-                }
-                else
+                if(used != 0)
                 {
-                    double  datum = v.getDouble();
-                    _writeBuf.pushData(&datum, sizeof(double));
+                    break;      // start the next window with this element
                 }
-                break;
+                data = child.peek(elementHeader + size, available, !lastMessage);
             }
-            case TE_UINT16:
+            ociter.setPosition(valPos);
+            ++valPos[2];
+            char* str = data + used + elementHeader;
+            if(available - used > elementHeader + size)
             {
-                if(v.isNull())
-                {
-                    _writeBuf.pushData(&_rNanInt32, sizeof(int32_t));
-                }
-                else
-                {
-                    int32_t datum = (int32_t) (v.getUint16());
-                    _writeBuf.pushData(&datum, sizeof(int32_t));
-                }
-                break;
+                // terminate the string in place for the copy into _val, then restore the byte of the next element
+                char const saved = str[size];
+                str[size] = 0;
+                _val.setData(str, size+1);
+                str[size] = saved;
             }
-            case TE_INT32:
+            else
             {
-                if(v.isNull())
-                {
-                    _writeBuf.pushData(&_rNanInt32, sizeof(int32_t));
-                }
-                else
+                if( (size_t) size+1 > _readBuf.size())
                 {
-                    int32_t datum = v.getInt32();
-                    _writeBuf.pushData(&datum, sizeof(int32_t));
+                    _readBuf.resize(size+1);
                 }
-                break;
-            }
-            default: throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unsupported type";
+                memcpy(&(_readBuf[0]), str, size);
+                _readBuf[size] = 0;
+                _val.setData( &(_readBuf[0]), size+1);
             }
-            ++(*citer);
+            ociter.writeItem(_val);
+            used += elementHeader + size;
         }
-        child.hardWrite(_writeBuf.data(), _writeBuf.size());
-    }
-    child.hardWrite(R_TAIL_HDR, sizeof(R_TAIL_HDR));
-    child.hardWrite(R_STRSXP, sizeof(R_STRSXP));
-    child.hardWrite(&numColumns, sizeof(int32_t));
-    for(size_t i =0; i<_inputTypes.size(); ++i)
-    {
-        child.hardWrite(R_CHARSXP, sizeof(R_CHARSXP));
-        int32_t nameSize = _inputNames[i].size();
-        child.hardWrite(&nameSize, sizeof(int32_t));
-        child.hardWrite(_inputNames[i].c_str(), nameSize);
+        child.skip(used);
     }
-    child.hardWrite(R_TAIL, sizeof(R_TAIL));
-}
-
-void DFInterface::writeFinalDF(ChildProcess& child)
-{
-    child.hardWrite(R_HEADER,  sizeof(R_HEADER));
-    child.hardWrite(R_EVECSXP, sizeof(R_VECSXP));
-    int32_t numColumns = 0;
-    child.hardWrite(&numColumns, sizeof(int32_t));
 }
 
 void DFInterface::readDF(ChildProcess& child, bool lastMessage)
 {
-    child.hardRead(&(_readBuf[0]), sizeof(R_HEADER) + sizeof(R_VECSXP), !lastMessage);
+    if(_readBuf.capacity() > READ_BUF_SIZE)
+    {
+        _readBuf = _arena.acquire(READ_BUF_SIZE); // give the buffer of a large response back to the arena
+    }
+    _readBuf.resize(READ_BUF_SIZE);
+    child.hardRead(&(_readBuf[0]), sizeof(R_HEADER), !lastMessage);
     int32_t intBuf;
+    child.hardRead(&intBuf, sizeof(int32_t), !lastMessage);
+    bool const hasAttributes = intBuf & R_HAS_ATTR;
     int32_t numColumns = -1;
     child.hardRead(&numColumns, sizeof(int32_t), !lastMessage);
     if (numColumns > 0 && numColumns != _nOutputAttrs)
@@ -295,17 +629,29 @@ void DFInterface::readDF(ChildProcess& child, bool lastMessage)
     }
     if (numColumns == 0)
     {
+        if(hasAttributes)
+        {
+            vector<string> symbols;
+            readAttributes(child, lastMessage, symbols);
+        }
         return;
     }
+    vector<string> symbols;     // the symbol reference table spans the whole message
     int32_t numRows;
     for(int32_t i =0; i<numColumns; ++i)
     {
-        switch(_outputTypes[i])
+        int32_t flags;
+        child.hardRead(&flags, sizeof(int32_t), !lastMessage);
+        int32_t const sexpType = flags & R_TYPE_MASK;
+        bool const isString = sexpType == R_STRSXP_TYPE;
+        // an integer vector with attributes may be a factor, whose levels are the strings of a string attribute
+        bool const maybeFactor = sexpType == R_INTSXP_TYPE && (flags & R_HAS_ATTR) && _outputTypes[i] == TE_STRING;
+        if((!maybeFactor && isString != (_outputTypes[i] == TE_STRING)) ||
+           (!isString && sexpType != R_LGLSXP_TYPE && sexpType != R_INTSXP_TYPE && sexpType != R_REALSXP_TYPE))
         {
-        case TE_STRING:     child.hardRead (&(_readBuf[0]),  sizeof (R_STRSXP),  !lastMessage);  break;
-        case TE_DOUBLE:     child.hardRead (&(_readBuf[0]),  sizeof (R_REALSXP), !lastMessage);  break;
-        case TE_INT32:      child.hardRead (&(_readBuf[0]),  sizeof (R_INTSXP),  !lastMessage);  break;
-        default:         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unknown type";
+            ostringstream error;
+            error<<"received a column of R type "<<sexpType<<" for output attribute "<<i<<" of type "<<typeEnum2TypeId(_outputTypes[i]);
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
         }
         if( i == 0)
         {
@@ -323,127 +669,257 @@ void DFInterface::readDF(ChildProcess& child, bool lastMessage)
                 throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received lists of different sizes";
             }
         }
+        shared_ptr<ChunkIterator> ociter;
+        if(numRows != 0)
+        {
+            ociter = _oaiters[i]->newChunk(_outPos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE  | ChunkIterator::NO_EMPTY_CHECK );
+            if(isString)
+            {
+                readStringColumn(child, lastMessage, *ociter, numRows);
+            }
+            else
+            {
+                size_t readSize = (sexpType == R_REALSXP_TYPE ? sizeof(double) : sizeof(int32_t)) * numRows;
+                if(readSize > _readBuf.size())
+                {
+                    _readBuf.resize(readSize);
+                }
+                child.hardRead (&(_readBuf[0]), readSize, !lastMessage);
+            }
+        }
+        // the attributes of a vector follow its data; the class tells integer64 from double and a factor from integers
+        vector<string> rClass;
+        if(flags & R_HAS_ATTR)
+        {
+            readColumnClass(child, lastMessage, symbols, rClass, maybeFactor ? &_levels : NULL);
+        }
+        // an ordered factor has class c("ordered", "factor")
+        if(maybeFactor && std::find(rClass.begin(), rClass.end(), "factor") == rClass.end())
+        {
+            ostringstream error;
+            error<<"received a column of R type "<<sexpType<<" for output attribute "<<i<<" of type "<<typeEnum2TypeId(_outputTypes[i]);
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+        }
         if(numRows == 0)
         {
             continue;
         }
-        switch(_outputTypes[i])
-        {
-        case TE_DOUBLE:
+        if(maybeFactor)
         {
-            size_t readSize = sizeof(double) * numRows;
-            if(readSize > _readBuf.size())
-            {
-                _readBuf.resize(readSize);
-            }
-            child.hardRead (&(_readBuf[0]), readSize, !lastMessage);
-            break;
+            storeFactorColumn(*ociter, numRows);
         }
-        case TE_INT32:
+        else if(sexpType == R_REALSXP_TYPE && std::find(rClass.begin(), rClass.end(), "integer64") != rClass.end())
         {
-            size_t readSize = sizeof(int32_t) * numRows;
-            if(readSize > _readBuf.size())
-            {
-                _readBuf.resize(readSize);
-            }
-            child.hardRead (&(_readBuf[0]), readSize, !lastMessage);
-            break;
+            readNumericColumn<int64_t>(_outputTypes[i], *ociter, numRows);
         }
-        case TE_STRING:
+        else if(sexpType == R_REALSXP_TYPE)
         {
-            break; // all below
+            readNumericColumn<double>(_outputTypes[i], *ociter, numRows);
         }
-        default:         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unknown type";
+        else if(!isString)
+        {
+            readNumericColumn<int32_t>(_outputTypes[i], *ociter, numRows);
         }
-        shared_ptr<ChunkIterator> ociter = _oaiters[i]->newChunk(_outPos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE  | ChunkIterator::NO_EMPTY_CHECK );
+        ociter->flush();
+    }
+    if(numRows != 0)
+    {
+        Value bmVal;
+        bmVal.setBool(true);                //populate the empty tag
+        shared_ptr<ChunkIterator> bmCiter = _oaiters[_nOutputAttrs]->newChunk(_outPos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE  | ChunkIterator::NO_EMPTY_CHECK );
         Coordinates valPos = _outPos;
-        for(int32_t j = 0; j<numRows; ++j)
+        for(int32_t j =0; j<numRows; ++j)
         {
-            ociter->setPosition(valPos);
-            switch(_outputTypes[i])
-            {
-            case TE_STRING:
+            bmCiter->setPosition(valPos);
+            bmCiter->writeItem(bmVal);
+            ++valPos[2];
+        }
+        bmCiter->flush();
+        _outPos[1]++;
+    }
+    if(hasAttributes)
+    {
+        readAttributes(child, lastMessage, symbols);
+    }
+}
+
+void DFInterface::readAttributes(ChildProcess& child, bool lastMessage, vector<string>& symbols)
+{
+    // the attributes are a pairlist of tagged values ending with R_NilValue; names come first, then any others
+    while(true)
+    {
+        int32_t flags;
+        child.hardRead(&flags, sizeof(int32_t), !lastMessage);
+        if((flags & R_TYPE_MASK) == R_NILVALUE_TYPE)
+        {
+            return;
+        }
+        if((flags & R_TYPE_MASK) != R_LISTSXP_TYPE || (flags & R_HAS_ATTR) || !(flags & R_HAS_TAG))
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received malformed list attributes";
+        }
+        string const tag = readSymbol(child, lastMessage, symbols);
+        bool const value = readAttributeValue(child, lastMessage);
+        if(tag == "stop" && value)
+        {
+            _stopRequested = true;
+        }
+    }
+}
+
+void DFInterface::readColumnClass(ChildProcess& child, bool lastMessage, vector<string>& symbols, vector<string>& rClass,
+                                  vector<Value>* levels)
+{
+    vector<Value> classes;
+    rClass.clear();
+    if(levels)
+    {
+        levels->clear();
+    }
+    while(true)
+    {
+        int32_t flags;
+        child.hardRead(&flags, sizeof(int32_t), !lastMessage);
+        if((flags & R_TYPE_MASK) == R_NILVALUE_TYPE)
+        {
+            return;
+        }
+        if((flags & R_TYPE_MASK) != R_LISTSXP_TYPE || (flags & R_HAS_ATTR) || !(flags & R_HAS_TAG))
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received malformed column attributes";
+        }
+        string const tag = readSymbol(child, lastMessage, symbols);
+        readAttributeValue(child, lastMessage, NULL, tag == "levels" ? levels : tag == "class" ? &classes : NULL);
+        if(tag == "class")
+        {
+            for(Value const& c : classes)
             {
-                child.hardRead(&(_readBuf[0]), sizeof(R_CHARSXP) + sizeof(int32_t), !lastMessage);
-                int32_t size = *((int32_t*) (&(_readBuf[0]) + sizeof(R_CHARSXP)));
-                if(size<-1)
+                if(!c.isNull())
                 {
-                    throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "error reading string size";
+                    rClass.push_back(c.getString());
                 }
-                if(size == -1)
-                {
-                    ociter->writeItem(_nullVal);
-                }
-                else
-                {
-                    if( (size_t) size+1 > _readBuf.size())
-                    {
-                        _readBuf.resize(size+1);
-                    }
-                    child.hardRead(&(_readBuf[0]), size, !lastMessage);
-                    _readBuf[size] = 0;
-                    _val.setData( &(_readBuf[0]), size+1);
-                    ociter->writeItem(_val);
-                }
-                break;
             }
-            case TE_DOUBLE:
+        }
+    }
+}
+
+string DFInterface::readSymbol(ChildProcess& child, bool lastMessage, vector<string>& symbols)
+{
+    int32_t flags;
+    child.hardRead(&flags, sizeof(int32_t), !lastMessage);
+    if((flags & R_TYPE_MASK) == R_REFSXP_TYPE)
+    {
+        // a symbol seen before, by its 1-based position in the reference table
+        uint32_t idx = ((uint32_t) flags) >> 8;
+        if(idx == 0)
+        {
+            child.hardRead(&idx, sizeof(int32_t), !lastMessage);
+        }
+        if(idx == 0 || idx > symbols.size())
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received invalid symbol reference";
+        }
+        return symbols[idx-1];
+    }
+    if((flags & R_TYPE_MASK) != R_SYMSXP_TYPE)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received malformed attribute name";
+    }
+    int32_t size;
+    child.hardRead(&flags, sizeof(int32_t), !lastMessage);
+    child.hardRead(&size, sizeof(int32_t), !lastMessage);
+    if((flags & R_TYPE_MASK) != R_CHARSXP_TYPE || size < 0)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received malformed attribute name";
+    }
+    string name(size, '\0');
+    if(size)
+    {
+        child.hardRead(&name[0], size, !lastMessage);
+    }
+    symbols.push_back(name);
+    return name;
+}
+
+bool DFInterface::readAttributeValue(ChildProcess& child, bool lastMessage, string* firstString, vector<Value>* strings)
+{
+    int32_t flags;
+    int32_t length;
+    child.hardRead(&flags, sizeof(int32_t), !lastMessage);
+    child.hardRead(&length, sizeof(int32_t), !lastMessage);
+    if((flags & R_HAS_ATTR) || length < 0)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received unsupported list attribute";
+    }
+    switch(flags & R_TYPE_MASK)
+    {
+    case R_STRSXP_TYPE:
+    {
+        // read into a string of its own; the data of the column before the attribute may still be in _readBuf
+        string text;
+        for(int32_t i = 0; i<length; ++i)
+        {
+            int32_t charFlags;
+            int32_t size;
+            child.hardRead(&charFlags, sizeof(int32_t), !lastMessage);
+            child.hardRead(&size, sizeof(int32_t), !lastMessage);
+            text.clear();
+            if(size > 0)
             {
-                double v = ((double*)(&(_readBuf[0])))[j];
-                if( memcmp(&v, &_rNanDouble, sizeof(double))==0)
-                {
-                    ociter->writeItem(_nullVal);
-                }
-                else
-                {
-                    _val.setDouble(v);
-                    ociter->writeItem(_val);
-                }
-                break;
+                text.resize(size);
+                child.hardRead(&text[0], size, !lastMessage);
             }
-            case TE_INT32:
+            if(i == 0 && firstString)
             {
-                int32_t v = ((int32_t*)(&(_readBuf[0])))[j];
-                if (v == _rNanInt32)
+                *firstString = text;
+            }
+            if(strings)
+            {
+                // as SciDB strings, with the terminating null, or null for NA
+                strings->push_back(Value());
+                if(size < 0)
                 {
-                    ociter->writeItem(_nullVal);
+                    strings->back().setNull();
                 }
                 else
                 {
-                    _val.setInt32(v);
-                    ociter->writeItem(_val);
+                    strings->back().setData(text.c_str(), size + 1);
                 }
-                break;
-            }
-            default:         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unknown type";
             }
-            ++valPos[2];
         }
-        ociter->flush();
+        return length > 0;
     }
-    if(numRows != 0)
+    case R_LGLSXP_TYPE:
+    case R_INTSXP_TYPE:
     {
-        Value bmVal;
-        bmVal.setBool(true);                //populate the empty tag
-        shared_ptr<ChunkIterator> bmCiter = _oaiters[_nOutputAttrs]->newChunk(_outPos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE  | ChunkIterator::NO_EMPTY_CHECK );
-        Coordinates valPos = _outPos;
-        for(int32_t j =0; j<numRows; ++j)
+        bool truth = false;
+        for(int32_t i = 0; i<length; ++i)
         {
-            bmCiter->setPosition(valPos);
-            bmCiter->writeItem(bmVal);
-            ++valPos[2];
+            int32_t v;
+            child.hardRead(&v, sizeof(int32_t), !lastMessage);
+            if(i == 0)
+            {
+                truth = v != 0 && v != _rNanInt32;
+            }
         }
-        bmCiter->flush();
-        _outPos[1]++;
+        return truth;
     }
-    child.hardRead(&(_readBuf[0]), sizeof(R_TAIL_HDR) + sizeof(R_STRSXP) + sizeof(int32_t), !lastMessage);
-    for(int32_t i =0; i<numColumns; ++i)
+    case R_REALSXP_TYPE:
     {
-        child.hardRead(&(_readBuf[0]), sizeof(R_CHARSXP), !lastMessage);
-        child.hardRead(&intBuf, sizeof(int32_t), !lastMessage);
-        child.hardRead(&(_readBuf[0]), intBuf, !lastMessage);
+        bool truth = false;
+        for(int32_t i = 0; i<length; ++i)
+        {
+            double v;
+            child.hardRead(&v, sizeof(double), !lastMessage);
+            if(i == 0)
+            {
+                truth = v != 0 && !std::isnan(v);
+            }
+        }
+        return truth;
+    }
+    default: throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received unsupported list attribute";
     }
-    child.hardRead(&(_readBuf[0]), sizeof(R_TAIL), !lastMessage);
 }
 
 }}
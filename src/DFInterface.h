@@ -28,12 +28,19 @@
 
 #include <query/PhysicalOperator.h>
 #include <query/TypeSystem.h>
+#include "BufferArena.h"
+#include "MessageBuilder.h"
+#include "DictionaryProbe.h"
+
+#include <unordered_map>
 
 namespace scidb { namespace stream
 {
 
 class Settings;
 class ChildProcess;
+class MessageRecorder;
+class Sampler;
 
 /**
  * Interface for streaming data in R data.frame format (abbreviated DF below).Converts SciDB data to DF and
@@ -46,8 +53,17 @@ class ChildProcess;
  *
  * list()
  *
- * Only 3 datatypes are supported: string, double, int32. All SciDB null codes convert to R NA values for
- * these types. In reverse, R NA values are converted to SciDB null (code 0).
+ * A response list may carry a logical "stop" attribute, set with attr(x, "stop") <- TRUE, to ask not to be sent any
+ * more data; the final empty message is still sent.
+ *
+ * SciDB types map to R vectors as follows: string as character, bool as logical, int8, int16, int32, uint8 and
+ * uint16 as integer, uint32, uint64, float and double as double, int64 as double or, with int64_as:'integer64', as
+ * bit64::integer64, and datetime as POSIXct; responses may hold bool, int32, int64, float, double, datetime and
+ * string outputs. All SciDB null codes convert to R NA values. In reverse, R NA values, and NaN for outputs that
+ * are not floating point, are converted to SciDB null (code 0).
+ *
+ * With the dictionary setting, string attributes are sent as factors, and a factor in a response is accepted for a
+ * string output attribute.
  */
 class DFInterface
 {
@@ -68,15 +84,27 @@ public:
      * @param settings the settings of the operator
      * @param outputSchema must be the result of a previous getOutputSchema call for these settings
      * @param query the query context
+     * @param arena the session buffer arena to draw read buffers from; must outlive the interface
      */
-    DFInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query);
+    DFInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query,
+                BufferArena& arena);
 
     /**
      * Set the interface to stream chunks from a given array. Must be called before streamData, when first
      * starting to stream and whenever the array that chunks are streamed from changes
      * @param inputSchema the schema of the array whose chunks will be streamed
+     * @param sampler if not NULL, only the cells it keeps are streamed; must outlive the streaming of the array
+     */
+    void setInputSchema(ArrayDesc const& inputSchema, Sampler const* sampler = NULL);
+
+    /**
+     * @return what the result cache must know of the input schema besides the messages: nothing, as every message
+     * carries the names and R types of its columns
      */
-    void setInputSchema(ArrayDesc const& inputSchema);
+    std::string getInputSchemaKey() const
+    {
+        return std::string();
+    }
 
     /**
      * Write data to the child and record the response into an internal array.
@@ -86,6 +114,48 @@ public:
      */
     void streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child);
 
+    /**
+     * Encode the message that streamData would send for the given chunks, without sending it or reading a response.
+     * @param inputChunks the data must match the attributes from the most recent setInputSchema call,
+     *                    excluding the empty tag.
+     * @param recorder the destination of the encoded message
+     * @return false if the chunks are empty and there is no message to send
+     */
+    bool encodeData(std::vector<ConstChunk const*> const& inputChunks, MessageRecorder& recorder);
+
+    /**
+     * Write a message previously produced by encodeData to the child and record the response into an internal array.
+     * @param message the encoded message, for the attributes of the most recent setInputSchema call
+     * @param child the process to stream to
+     */
+    void streamEncoded(std::vector<char> const& message, ChildProcess& child);
+
+    /**
+     * Read the response of the child to a message, or a response replayed by the child, into the internal array.
+     * @param child the process to read from
+     */
+    void readResponse(ChildProcess& child)
+    {
+        readDF(child);
+    }
+
+    /**
+     * @return true, as every DF response is a complete R serialization that decodes on its own when replayed from
+     * the result cache
+     */
+    bool isResponseCacheable() const
+    {
+        return true;
+    }
+
+    /**
+     * @return true if a response from the child asked not to be sent any more data
+     */
+    bool isStopRequested() const
+    {
+        return _stopRequested;
+    }
+
     /**
      * Finish the interaction, write the terminating message to the child and return a pointer to the array
      * containing all the accumulated result data. This object is invalidated after this call.
@@ -95,46 +165,7 @@ public:
     std::shared_ptr<Array> finalize(ChildProcess& child);
 
 private:
-    class EasyBuffer
-    {
-    private:
-        std::vector<char> _data;
-        size_t       _end;
-
-    public:
-        EasyBuffer(size_t initialCapacity = 1024*1024):
-            _data(initialCapacity),
-            _end(0)
-        {}
-
-        void pushData(void const* data, size_t size)
-        {
-            if(_end + size > _data.size())
-            {
-                _data.resize(_end + size);
-            }
-            memcpy((&(_data[_end])), data, size);
-            _end += size;
-        }
-
-        void reset()
-        {
-            _end   = 0;
-        }
-
-        /**
-         * Result of this call is invalidated after next pushData call
-         */
-        void* data()
-        {
-            return (&_data[0]);
-        }
-
-        size_t size()
-        {
-            return _end;
-        }
-    };
+    static size_t const READ_BUF_SIZE = 1024*1024;
 
     std::shared_ptr<Query>                         _query;
     std::shared_ptr<Array>                         _result;
@@ -143,18 +174,56 @@ private:
     int32_t                                        _nOutputAttrs;
     std::vector< std::shared_ptr<ArrayIterator> >  _oaiters;
     std::vector <TypeEnum>                         _outputTypes;
-    std::vector<char>                              _readBuf;
-    EasyBuffer                                     _writeBuf;
+    BufferArena&                                   _arena;
+    BufferArena::Buffer                            _readBuf;
+    BufferArena::Buffer                            _writeBuf;
+    MessageBuilder                                 _message;
     Value                                          _val;
     Value                                          _nullVal;
     std::vector <TypeEnum>                         _inputTypes;
     std::vector <std::string>                      _inputNames;
+    Sampler const*                                 _sampler;
+    std::vector<char>                              _mask;
+    std::vector<uint8_t>                           _naMask;
+    bool                                           _stopRequested;
     int32_t                                        _rNanInt32;
     double                                         _rNanDouble;
 
-    void writeDF(std::vector<ConstChunk const*> const& chunks, int32_t const numRows, ChildProcess& child);
+    typedef void (DFInterface::*ColumnWriter)(ConstChunkIterator& citer, int32_t const numRows);
+    std::vector<ColumnWriter>                      _columnWriters;
+    std::vector<int32_t>                           _columnFlags;
+    std::vector<std::string>                       _columnAttributes;
+    bool                                           _int64AsInteger64;
+    DictionaryEncoding                             _dictionaryEncoding;
+    std::unordered_map<std::string, int32_t>       _factorCodes;
+    std::vector<std::string>                       _factorLevels;
+    std::string                                    _factorAttributes;
+    std::string                                    _factorKey;
+    std::vector<Value>                             _levels;
+
+    size_t checkInputChunks(std::vector<ConstChunk const*> const& inputChunks);
+    template <class OUTPUT>
+    void writeDF(std::vector<ConstChunk const*> const& chunks, int32_t const numRows, OUTPUT& out);
     void writeFinalDF(ChildProcess& child);
+    template <typename R_T>
+    R_T rNA() const;
+    template <typename SCIDB_T, typename R_T>
+    void writeNumericColumn(ConstChunkIterator& citer, int32_t const numRows);
+    void writeStringColumn(ConstChunkIterator& citer, int32_t const numRows);
+    void writeFactorColumn(ConstChunkIterator& citer, int32_t const numRows);
+    template <typename R_T, typename SCIDB_T>
+    void storeNumericColumn(ChunkIterator& ociter, int32_t const numRows);
+    template <typename R_T>
+    void readNumericColumn(TypeEnum const outputType, ChunkIterator& ociter, int32_t const numRows);
+    void readStringColumn(ChildProcess& child, bool lastMessage, ChunkIterator& ociter, int32_t const numRows);
+    void storeFactorColumn(ChunkIterator& ociter, int32_t const numRows);
     void readDF(ChildProcess& child, bool lastMessage = false);
+    void readAttributes(ChildProcess& child, bool lastMessage, std::vector<std::string>& symbols);
+    void readColumnClass(ChildProcess& child, bool lastMessage, std::vector<std::string>& symbols,
+                         std::vector<std::string>& rClass, std::vector<Value>* levels = NULL);
+    std::string readSymbol(ChildProcess& child, bool lastMessage, std::vector<std::string>& symbols);
+    bool readAttributeValue(ChildProcess& child, bool lastMessage, std::string* firstString = NULL,
+                            std::vector<Value>* strings = NULL);
 };
 
 
@@ -0,0 +1,54 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "DictionaryProbe.h"
+#include <unordered_set>
+
+namespace scidb { namespace stream {
+
+bool DictionaryProbe::isLowCardinality(ConstChunk const& chunk)
+{
+    std::unordered_set<std::string> distinct;
+    size_t probed = 0;
+    shared_ptr<ConstChunkIterator> citer = chunk.getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
+    for(; !citer->end() && probed < PROBE_CELLS; ++(*citer))
+    {
+        Value const& value = citer->getItem();
+        if(value.isNull())
+        {
+            continue;
+        }
+        ++probed;
+        distinct.insert(std::string(value.getString(), value.size() - 1));
+        if(distinct.size() > PROBE_CELLS / 4)
+        {
+            // too many already, whatever the rest of the probe holds
+            return false;
+        }
+    }
+    return distinct.size() <= probed / 4;
+}
+
+} }
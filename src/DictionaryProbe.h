@@ -0,0 +1,66 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_DICTIONARYPROBE_H_
+#define SRC_DICTIONARYPROBE_H_
+
+#include <query/PhysicalOperator.h>
+#include "StreamSettings.h"
+
+namespace scidb { namespace stream
+{
+
+/**
+ * Decides whether the strings of a chunk are sent dictionary-encoded. With the dictionary:'auto' setting the
+ * distinct strings among the first cells of the chunk are counted, and the chunk is encoded when they repeat enough
+ * for the indices and the dictionary to be smaller than the strings.
+ */
+class DictionaryProbe
+{
+public:
+    /**
+     * The number of non-null cells probed at the start of a chunk.
+     */
+    static size_t const PROBE_CELLS = 1024;
+
+    /**
+     * @param encoding the dictionary setting of the operator
+     * @param chunk a chunk of a string attribute
+     * @return true if the strings of the chunk should be dictionary-encoded
+     */
+    static bool useDictionary(DictionaryEncoding encoding, ConstChunk const& chunk)
+    {
+        return encoding == DICTIONARY_ALWAYS || (encoding == DICTIONARY_AUTO && isLowCardinality(chunk));
+    }
+
+    /**
+     * @return true if at most a quarter of the probed cells of the chunk are distinct strings
+     */
+    static bool isLowCardinality(ConstChunk const& chunk);
+};
+
+} }
+
+#endif /* SRC_DICTIONARYPROBE_H_ */
@@ -25,12 +25,17 @@
 
 #include "StreamSettings.h"
 #include "ChildProcess.h"
+#include "Sampler.h"
 #include "FeatherInterface.h"
 
+#include <cmath>
+#include <limits>
 #include <array/MemArray.h>
 #include <arrow/io/memory.h>
 #include <arrow/ipc/reader.h>
 #include <arrow/ipc/writer.h>
+#include <arrow/util/bit_run_reader.h>
+#include <arrow/util/compression.h>
 
 #define THROW_NOT_OK(s)                                                 \
     {                                                                   \
@@ -52,6 +57,110 @@
 
 namespace scidb { namespace stream {
 
+char const* const FeatherInterface::COMPRESSION_ENV_VAR = "SCIDB_STREAM_COMPRESSION";
+
+/**
+ * An Arrow output stream that appends to an arena buffer, so that the encoded record batches of all messages reuse
+ * the same memory.
+ */
+class ArenaOutputStream : public arrow::io::OutputStream
+{
+public:
+    explicit ArenaOutputStream(BufferArena::Buffer& buf):
+        _buf(buf),
+        _closed(false)
+    {
+        _buf.clear();
+    }
+
+    arrow::Status Close() override
+    {
+        _closed = true;
+        return arrow::Status::OK();
+    }
+
+    bool closed() const override
+    {
+        return _closed;
+    }
+
+    arrow::Result<int64_t> Tell() const override
+    {
+        return (int64_t) _buf.size();
+    }
+
+    using arrow::io::OutputStream::Write;
+
+    arrow::Status Write(const void* data, int64_t nbytes) override
+    {
+        _buf.append(data, nbytes);
+        return arrow::Status::OK();
+    }
+
+private:
+    BufferArena::Buffer& _buf;
+    bool                 _closed;
+};
+
+/**
+ * The messages of the child's stream, one response at a time, for a record batch reader that lasts as long as the
+ * stream, so that dictionaries the child does not send again still apply. The messages are read in place from the
+ * read buffer, except for the schema and the dictionaries, which are kept past the response in copies.
+ */
+class ResponseMessageReader : public arrow::ipc::MessageReader
+{
+public:
+    /**
+     * Read the messages of a response next.
+     * @param response the messages, valid until the reader returns NULL at its end
+     * @param schemaMessage if not NULL, a schema message to read ahead of the response
+     */
+    void setResponse(std::shared_ptr<arrow::Buffer> const& response,
+                     std::shared_ptr<arrow::Buffer> const& schemaMessage)
+    {
+        _response.reset(new arrow::io::BufferReader(response));
+        _schemaMessage = schemaMessage;
+    }
+
+    arrow::Result<std::unique_ptr<arrow::ipc::Message>> ReadNextMessage() override
+    {
+        if (_schemaMessage != NULL)
+        {
+            arrow::io::BufferReader schemaReader(_schemaMessage);
+            _schemaMessage.reset();
+            return arrow::ipc::ReadMessage(&schemaReader);
+        }
+        if (_response == NULL)
+        {
+            return std::unique_ptr<arrow::ipc::Message>();
+        }
+        ARROW_ASSIGN_OR_RAISE(int64_t const start, _response->Tell());
+        ARROW_ASSIGN_OR_RAISE(std::unique_ptr<arrow::ipc::Message> message, arrow::ipc::ReadMessage(_response.get()));
+        if (message == NULL)
+        {
+            // the end of the response, or the end-of-stream marker of a child that closes its stream every time
+            _response.reset();
+        }
+        else if (message->type() == arrow::ipc::MessageType::SCHEMA)
+        {
+            return arrow::Status::Invalid("received an Arrow schema after the start of a response from client");
+        }
+        else if (message->type() == arrow::ipc::MessageType::DICTIONARY_BATCH)
+        {
+            ARROW_ASSIGN_OR_RAISE(int64_t const end, _response->Tell());
+            ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Buffer> const copy,
+                                  _response->buffer()->CopySlice(start, end - start));
+            arrow::io::BufferReader copyReader(copy);
+            return arrow::ipc::ReadMessage(&copyReader);
+        }
+        return std::move(message);
+    }
+
+private:
+    std::unique_ptr<arrow::io::BufferReader> _response;
+    std::shared_ptr<arrow::Buffer>           _schemaMessage;
+};
+
 ArrayDesc FeatherInterface::getOutputSchema(
     std::vector<ArrayDesc> const& inputSchemas,
     Settings const& settings,
@@ -121,9 +230,534 @@ ArrayDesc FeatherInterface::getOutputSchema(
                      query->getDefaultArrayResidency());
 }
 
+template <typename BUILDER, typename SCIDB_T>
+arrow::Status FeatherInterface::appendNumericColumn(ConstChunkIterator& citer,
+                                                    arrow::ArrayBuilder& builder,
+                                                    int32_t const numRows)
+{
+    BUILDER& typedBuilder = static_cast<BUILDER&>(builder);
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    int32_t row = 0;
+    for(size_t cell = 0; !citer.end() && row < numRows; ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            typedBuilder.UnsafeAppendNull();
+        }
+        else
+        {
+            typedBuilder.UnsafeAppend(value.get<SCIDB_T>());
+        }
+        ++row;
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status FeatherInterface::appendStringColumn(ConstChunkIterator& citer,
+                                                   arrow::ArrayBuilder& builder,
+                                                   int32_t const numRows)
+{
+    arrow::StringBuilder& typedBuilder = static_cast<arrow::StringBuilder&>(builder);
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.AppendNull());
+        }
+        else
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.Append(value.getString()));
+        }
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status FeatherInterface::appendDictionaryColumn(ConstChunkIterator& citer,
+                                                       arrow::ArrayBuilder& builder,
+                                                       int32_t const numRows)
+{
+    arrow::StringDictionary32Builder& typedBuilder = static_cast<arrow::StringDictionary32Builder&>(builder);
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.AppendNull());
+        }
+        else
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.Append(value.getString(), (int32_t) value.size() - 1));
+        }
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status FeatherInterface::appendBinaryColumn(ConstChunkIterator& citer,
+                                                   arrow::ArrayBuilder& builder,
+                                                   int32_t const numRows)
+{
+    arrow::BinaryBuilder& typedBuilder = static_cast<arrow::BinaryBuilder&>(builder);
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.AppendNull());
+        }
+        else
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.Append((const uint8_t*)value.data(), value.size()));
+        }
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status FeatherInterface::appendFixedSizeBinaryColumn(ConstChunkIterator& citer,
+                                                            arrow::ArrayBuilder& builder,
+                                                            int32_t const numRows)
+{
+    arrow::FixedSizeBinaryBuilder& typedBuilder = static_cast<arrow::FixedSizeBinaryBuilder&>(builder);
+    size_t const width = (size_t) typedBuilder.byte_width();
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.AppendNull());
+        }
+        else if(value.size() != width)
+        {
+            return arrow::Status::Invalid("value of ", value.size(), " bytes in a column of width ", width);
+        }
+        else
+        {
+            ARROW_RETURN_NOT_OK(typedBuilder.Append((const uint8_t*)value.data()));
+        }
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status FeatherInterface::appendCharColumn(ConstChunkIterator& citer,
+                                                 arrow::ArrayBuilder& builder,
+                                                 int32_t const numRows)
+{
+    // a char is a string of one character, or an empty string for the NUL character
+    arrow::StringBuilder& typedBuilder = static_cast<arrow::StringBuilder&>(builder);
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    ARROW_RETURN_NOT_OK(typedBuilder.ReserveData(numRows));
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            typedBuilder.UnsafeAppendNull();
+        }
+        else
+        {
+            char const c = value.getChar();
+            typedBuilder.UnsafeAppend(&c, c == 0 ? 0 : 1);
+        }
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status FeatherInterface::appendDateTimeTzColumn(ConstChunkIterator& citer,
+                                                       arrow::ArrayBuilder& builder,
+                                                       int32_t const numRows)
+{
+    // A datetimetz is the local time and its offset from UTC, in seconds. Arrow keeps one time zone per column,
+    // so the values are sent in UTC.
+    arrow::TimestampBuilder& typedBuilder = static_cast<arrow::TimestampBuilder&>(builder);
+    ARROW_RETURN_NOT_OK(typedBuilder.Reserve(numRows));
+    for(size_t cell = 0; !citer.end(); ++cell, ++citer)
+    {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            continue;
+        }
+        Value const& value = citer.getItem();
+        if(value.isNull())
+        {
+            typedBuilder.UnsafeAppendNull();
+        }
+        else
+        {
+            int64_t const* localAndOffset = (int64_t const*) value.data();
+            typedBuilder.UnsafeAppend(localAndOffset[0] - localAndOffset[1]);
+        }
+    }
+    return arrow::Status::OK();
+}
+
+template <typename WRITE_VALUE>
+void FeatherInterface::readColumn(arrow::Array const& array,
+                                  ChunkIterator& ociter,
+                                  WRITE_VALUE const& writeValue)
+{
+    // Walk the validity bitmap a run of valid or null values at a time rather than testing every bit, and write
+    // the cells of the output chunk in order
+    int64_t const numRows = array.length();
+    ociter.setPosition(_outPos);
+    if (array.null_count() == 0)
+    {
+        for(int64_t j = 0; j < numRows; ++j, ++ociter)
+        {
+            writeValue(j);
+        }
+        return;
+    }
+    arrow::internal::BitRunReader runs(array.null_bitmap_data(), array.offset(), numRows);
+    for(int64_t j = 0; j < numRows; )
+    {
+        arrow::internal::BitRun const run = runs.NextRun();
+        int64_t const runEnd = j + run.length;
+        if (run.set)
+        {
+            for(; j < runEnd; ++j, ++ociter)
+            {
+                writeValue(j);
+            }
+        }
+        else
+        {
+            for(; j < runEnd; ++j, ++ociter)
+            {
+                ociter.writeItem(_nullVal);
+            }
+        }
+    }
+}
+
+/**
+ * @return true if value v of a column converts to output type C_T without wrapping around or leaving the range of
+ * C_T; any number converts to bool, and floating point values are truncated towards zero
+ */
+template <typename C_T, typename ARROW_C_T>
+static bool isInRange(ARROW_C_T v)
+{
+    if(std::is_same<C_T, bool>::value)
+    {
+        return true;
+    }
+    if(std::is_floating_point<C_T>::value)
+    {
+        return sizeof(C_T) >= sizeof(ARROW_C_T) || !std::isfinite((double) v) ||
+            std::fabs((double) v) <= (double) std::numeric_limits<C_T>::max();
+    }
+    if(std::is_floating_point<ARROW_C_T>::value)
+    {
+        // the bounds of every integer type are exact in long double
+        long double const d = v;
+        return d > (long double) std::numeric_limits<C_T>::min() - 1 && d < (long double) std::numeric_limits<C_T>::max() + 1;
+    }
+    if(std::is_signed<ARROW_C_T>::value && (intmax_t) v < 0)
+    {
+        return std::is_signed<C_T>::value && (intmax_t) v >= (intmax_t) std::numeric_limits<C_T>::min();
+    }
+    return (uintmax_t) v <= (uintmax_t) std::numeric_limits<C_T>::max();
+}
+
+template <typename ARROW_C_T, typename C_T>
+void FeatherInterface::readNumericValues(arrow::Array const& array,
+                                         ChunkIterator& ociter)
+{
+    // NaN has no integer, bool or datetime equivalent and becomes null along with the null values, as in
+    // DFInterface; any other value that does not fit the output fails the query, as in TSVInterface
+    bool const nanIsNull = std::is_floating_point<ARROW_C_T>::value && !std::is_floating_point<C_T>::value;
+    ARROW_C_T const* arrayData = array.data()->GetValues<ARROW_C_T>(1);
+    readColumn(array, ociter, [&](int64_t j)
+    {
+        ARROW_C_T const v = arrayData[j];
+        if(nanIsNull && std::isnan((double) v))
+        {
+            ociter.writeItem(_nullVal);
+            return;
+        }
+        if(!isInRange<C_T>(v))
+        {
+            ostringstream error;
+            error<<"received a value of "<<+v<<" in a column of type "<<array.type()->ToString()
+                 <<", out of range of the output type";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+        }
+        _val.set<C_T>(static_cast<C_T>(v));
+        ociter.writeItem(_val);
+    });
+}
+
+template <typename C_T>
+void FeatherInterface::readNumericColumn(arrow::Array const& array,
+                                         ChunkIterator& ociter)
+{
+    // Any numeric column converts to any numeric output whose range holds its values, so that a child is free to
+    // widen its columns, as pandas does with integers next to nulls
+    switch(array.type_id())
+    {
+    case arrow::Type::BOOL:
+    {
+        arrow::BooleanArray const& arrayBool = static_cast<arrow::BooleanArray const&>(array);
+        readColumn(array, ociter, [&](int64_t j)
+        {
+            _val.set<C_T>(static_cast<C_T>(arrayBool.Value(j)));
+            ociter.writeItem(_val);
+        });
+        break;
+    }
+    case arrow::Type::INT8:   readNumericValues<int8_t, C_T>(array, ociter);   break;
+    case arrow::Type::INT16:  readNumericValues<int16_t, C_T>(array, ociter);  break;
+    case arrow::Type::INT32:  readNumericValues<int32_t, C_T>(array, ociter);  break;
+    case arrow::Type::INT64:  readNumericValues<int64_t, C_T>(array, ociter);  break;
+    case arrow::Type::UINT8:  readNumericValues<uint8_t, C_T>(array, ociter);  break;
+    case arrow::Type::UINT16: readNumericValues<uint16_t, C_T>(array, ociter); break;
+    case arrow::Type::UINT32: readNumericValues<uint32_t, C_T>(array, ociter); break;
+    case arrow::Type::UINT64: readNumericValues<uint64_t, C_T>(array, ociter); break;
+    case arrow::Type::FLOAT:  readNumericValues<float, C_T>(array, ociter);    break;
+    case arrow::Type::DOUBLE: readNumericValues<double, C_T>(array, ociter);   break;
+    default:
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << "received a column of type " << array.type()->ToString() << " for numeric output";
+    }
+}
+
+template <typename WRITE_SECONDS>
+void FeatherInterface::readSeconds(arrow::Array const& array,
+                                   ChunkIterator& ociter,
+                                   WRITE_SECONDS const& writeSeconds)
+{
+    // Timestamps of any unit, dates, and integers taken as seconds, are rounded down to seconds since the epoch
+    int64_t divisor = 1;
+    switch(array.type_id())
+    {
+    case arrow::Type::TIMESTAMP:
+        switch(static_cast<arrow::TimestampType const&>(*array.type()).unit())
+        {
+        case arrow::TimeUnit::SECOND: break;
+        case arrow::TimeUnit::MILLI:  divisor = 1000;       break;
+        case arrow::TimeUnit::MICRO:  divisor = 1000000;    break;
+        case arrow::TimeUnit::NANO:   divisor = 1000000000; break;
+        }
+        break;
+    case arrow::Type::DATE32:
+    {
+        int32_t const* arrayData = array.data()->GetValues<int32_t>(1);
+        readColumn(array, ociter, [&](int64_t j)
+        {
+            writeSeconds(arrayData[j] * (int64_t) 86400);
+        });
+        return;
+    }
+    case arrow::Type::DATE64: divisor = 1000; break;
+    case arrow::Type::INT64:  break;
+    default:
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << "received a column of type " << array.type()->ToString() << " for datetime output";
+    }
+    int64_t const* arrayData = array.data()->GetValues<int64_t>(1);
+    readColumn(array, ociter, [&](int64_t j)
+    {
+        int64_t const value = arrayData[j];
+        int64_t seconds = value / divisor;
+        if (value % divisor < 0)
+        {
+            --seconds;
+        }
+        writeSeconds(seconds);
+    });
+}
+
+void FeatherInterface::readDateTimeColumn(arrow::Array const& array,
+                                          ChunkIterator& ociter)
+{
+    readSeconds(array, ociter, [&](int64_t seconds)
+    {
+        _val.setDateTime(seconds);
+        ociter.writeItem(_val);
+    });
+}
+
+void FeatherInterface::readDateTimeTzColumn(arrow::Array const& array,
+                                            ChunkIterator& ociter)
+{
+    // in UTC, with no offset
+    readSeconds(array, ociter, [&](int64_t seconds)
+    {
+        int64_t const localAndOffset[2] = { seconds, 0 };
+        _val.setData(localAndOffset, sizeof(localAndOffset));
+        ociter.writeItem(_val);
+    });
+}
+
+void FeatherInterface::readCharColumn(arrow::Array const& array,
+                                      ChunkIterator& ociter)
+{
+    if (array.type_id() != arrow::Type::STRING)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << "received a column of type " << array.type()->ToString() << " for char output";
+    }
+    arrow::StringArray const& arrayString = static_cast<arrow::StringArray const&>(array);
+    readColumn(array, ociter, [&](int64_t j)
+    {
+        int32_t size;
+        uint8_t const* str = arrayString.GetValue(j, &size);
+        if (size > 1)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+                << "received a string of more than one character for char output";
+        }
+        _val.setChar(size == 0 ? 0 : (char) str[0]);
+        ociter.writeItem(_val);
+    });
+}
+
+void FeatherInterface::readStringColumn(arrow::Array const& array,
+                                        ChunkIterator& ociter)
+{
+    if (array.type_id() != arrow::Type::STRING)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << "received a column of type " << array.type()->ToString() << " for string output";
+    }
+    arrow::StringArray const& arrayString = static_cast<arrow::StringArray const&>(array);
+    // Strings in Arrow arrays are not null-terminated. Those in the read buffer are terminated in place for the
+    // copy into _val, restoring the byte of the next string after; the buffer has a spare byte past the response.
+    char* const values = (char*) arrayString.value_data()->data();
+    bool const inPlace = values >= _readBuf.data() && values < _readBuf.data() + _readBuf.size();
+    readColumn(array, ociter, [&](int64_t j)
+    {
+        char* str = values + arrayString.value_offset(j);
+        int32_t const size = arrayString.value_length(j);
+        if (inPlace)
+        {
+            char const saved = str[size];
+            str[size] = 0;
+            _val.setData(str, size + 1);
+            str[size] = saved;
+        }
+        else
+        {
+            _scratch.assign(str, size);
+            _val.setData(_scratch.c_str(), size + 1);
+        }
+        ociter.writeItem(_val);
+    });
+}
+
+void FeatherInterface::readBinaryColumn(arrow::Array const& array,
+                                        ChunkIterator& ociter)
+{
+    if (array.type_id() == arrow::Type::FIXED_SIZE_BINARY)
+    {
+        // such as the UDT columns that were sent to the child
+        arrow::FixedSizeBinaryArray const& arrayFixed = static_cast<arrow::FixedSizeBinaryArray const&>(array);
+        int32_t const width = arrayFixed.byte_width();
+        readColumn(array, ociter, [&](int64_t j)
+        {
+            _val.setData(arrayFixed.GetValue(j), width);
+            ociter.writeItem(_val);
+        });
+        return;
+    }
+    // StringArray is a BinaryArray
+    if (array.type_id() != arrow::Type::BINARY && array.type_id() != arrow::Type::STRING)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << "received a column of type " << array.type()->ToString() << " for binary output";
+    }
+    arrow::BinaryArray const& arrayBinary = static_cast<arrow::BinaryArray const&>(array);
+    readColumn(array, ociter, [&](int64_t j)
+    {
+        int32_t sz_val;
+        const uint8_t* ptr_val = arrayBinary.GetValue(j, &sz_val);
+        _val.setData(ptr_val, sz_val);
+        ociter.writeItem(_val);
+    });
+}
+
+void FeatherInterface::readDictionaryColumn(arrow::Array const& array,
+                                            ChunkIterator& ociter,
+                                            TypeEnum const outputType)
+{
+    arrow::DictionaryArray const& arrayDictionary = static_cast<arrow::DictionaryArray const&>(array);
+    arrow::Array const& dictionary = *arrayDictionary.dictionary();
+    if (!(outputType == TE_STRING && dictionary.type_id() == arrow::Type::STRING) &&
+        !(outputType == TE_BINARY && dictionary.type_id() == arrow::Type::BINARY))
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << "received a dictionary column that does not match its string or binary output type";
+    }
+    // StringArray is a BinaryArray. Every dictionary value is converted once for the chunk, the first time a cell
+    // refers to it, rather than once per cell.
+    arrow::BinaryArray const& values = static_cast<arrow::BinaryArray const&>(dictionary);
+    int64_t const numValues = values.length();
+    _dictionaryValues.resize(numValues);
+    _dictionaryCached.assign(numValues, 0);
+    readColumn(array, ociter, [&](int64_t j)
+    {
+        int64_t const k = arrayDictionary.GetValueIndex(j);
+        if (k < 0 || k >= numValues)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+                << "received a dictionary index out of range";
+        }
+        Value& value = _dictionaryValues[k];
+        if (!_dictionaryCached[k])
+        {
+            int32_t size;
+            uint8_t const* data = values.GetValue(k, &size);
+            if (values.IsNull(k))
+            {
+                value.setNull();
+            }
+            else if (outputType == TE_STRING)
+            {
+                _scratch.assign((char const*) data, size);
+                value.setData(_scratch.c_str(), size + 1);
+            }
+            else
+            {
+                value.setData(data, size);
+            }
+            _dictionaryCached[k] = 1;
+        }
+        ociter.writeItem(value);
+    });
+}
+
 FeatherInterface::FeatherInterface(Settings const& settings,
                                    ArrayDesc const& outputSchema,
-                                   std::shared_ptr<Query> const& query):
+                                   std::shared_ptr<Query> const& query,
+                                   BufferArena& arena):
     _query(query),
     _result(new MemArray(outputSchema, query)),
     _outPos{((Coordinate) _query->getInstanceID()), 0, 0},
@@ -131,8 +765,27 @@ FeatherInterface::FeatherInterface(Settings const& settings,
     _nOutputAttrs((int32_t)outputSchema.getAttributes(true).size()),
     _oaiters(_nOutputAttrs + 1),
     _outputTypes(settings.getTypes()),
-    _readBuf(1024*1024)
+    _arena(arena),
+    _readBuf(arena.acquire(READ_BUF_SIZE)),
+    _writeBuf(arena.acquire(READ_BUF_SIZE)),
+    _dictionaryEncoding(settings.getDictionaryEncoding()),
+    _sampler(NULL),
+    _stopRequested(false),
+    _schemaEncoded(false),
+    _responses(NULL),
+    _dictionariesRead(false),
+    _responseCacheable(true),
+    _ipcWriteOptions(arrow::ipc::IpcWriteOptions::Defaults())
 {
+    // Compress the record batches sent to the child; compressed responses are decompressed by the reader as they
+    // come, whatever the setting
+    if (!settings.getCompression().empty())
+    {
+        arrow::Compression::type const codec =
+            settings.getCompression() == "zstd" ? arrow::Compression::ZSTD : arrow::Compression::LZ4_FRAME;
+        ASSIGN_OR_THROW(_ipcWriteOptions.codec, arrow::util::Codec::Create(codec));
+    }
+
     // Set output iterators
     size_t i = 0;
     for (const auto& attr : outputSchema.getAttributes(true))
@@ -143,15 +796,56 @@ FeatherInterface::FeatherInterface(Settings const& settings,
     _oaiters[_nOutputAttrs] = _result->getIterator(
         *outputSchema.getEmptyBitmapAttribute());
     _nullVal.setNull();
+
+    // Pick the conversion kernel of every output column once, and the schema that the output types imply. A
+    // response without a schema, such as one replayed from the result cache, is read with that schema until the
+    // child sends one.
+    _columnReaders.resize(_nOutputAttrs);
+    std::vector<std::shared_ptr<arrow::Field>> arrowFields(_nOutputAttrs);
+    i = 0;
+    for (const auto& attr : outputSchema.getAttributes(true))
+    {
+        std::shared_ptr<arrow::DataType> arrowType;
+        switch(_outputTypes[i])
+        {
+        case TE_BOOL:       _columnReaders[i] = &FeatherInterface::readNumericColumn<bool>;     arrowType = arrow::boolean(); break;
+        case TE_CHAR:       _columnReaders[i] = &FeatherInterface::readCharColumn;              arrowType = arrow::utf8();    break;
+        case TE_DATETIME:   _columnReaders[i] = &FeatherInterface::readDateTimeColumn;
+                            arrowType = arrow::timestamp(arrow::TimeUnit::SECOND);                                        break;
+        case TE_DATETIMETZ: _columnReaders[i] = &FeatherInterface::readDateTimeTzColumn;
+                            arrowType = arrow::timestamp(arrow::TimeUnit::SECOND, "UTC");                                 break;
+        case TE_DOUBLE:     _columnReaders[i] = &FeatherInterface::readNumericColumn<double>;   arrowType = arrow::float64(); break;
+        case TE_FLOAT:      _columnReaders[i] = &FeatherInterface::readNumericColumn<float>;    arrowType = arrow::float32(); break;
+        case TE_INT8:       _columnReaders[i] = &FeatherInterface::readNumericColumn<int8_t>;   arrowType = arrow::int8();    break;
+        case TE_INT16:      _columnReaders[i] = &FeatherInterface::readNumericColumn<int16_t>;  arrowType = arrow::int16();   break;
+        case TE_INT32:      _columnReaders[i] = &FeatherInterface::readNumericColumn<int32_t>;  arrowType = arrow::int32();   break;
+        case TE_INT64:      _columnReaders[i] = &FeatherInterface::readNumericColumn<int64_t>;  arrowType = arrow::int64();   break;
+        case TE_UINT8:      _columnReaders[i] = &FeatherInterface::readNumericColumn<uint8_t>;  arrowType = arrow::uint8();   break;
+        case TE_UINT16:     _columnReaders[i] = &FeatherInterface::readNumericColumn<uint16_t>; arrowType = arrow::uint16();  break;
+        case TE_UINT32:     _columnReaders[i] = &FeatherInterface::readNumericColumn<uint32_t>; arrowType = arrow::uint32();  break;
+        case TE_UINT64:     _columnReaders[i] = &FeatherInterface::readNumericColumn<uint64_t>; arrowType = arrow::uint64();  break;
+        case TE_STRING:     _columnReaders[i] = &FeatherInterface::readStringColumn;            arrowType = arrow::utf8();    break;
+        case TE_BINARY:     _columnReaders[i] = &FeatherInterface::readBinaryColumn;            arrowType = arrow::binary();  break;
+        default: throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL,
+                                        SCIDB_LE_ILLEGAL_OPERATION)
+            << "internal error: unknown type";
+        }
+        arrowFields[i] = arrow::field(attr.getName(), arrowType);
+        i++;
+    }
+    ASSIGN_OR_THROW(_declaredSchemaMessage, arrow::ipc::SerializeSchema(*arrow::schema(arrowFields), _arrowPool));
+    _outputSchemaMessage = _declaredSchemaMessage;
 }
 
-void FeatherInterface::setInputSchema(ArrayDesc const& inputSchema)
+void FeatherInterface::setInputSchema(ArrayDesc const& inputSchema, Sampler const* sampler)
 {
+    _sampler = sampler;
     Attributes const& attrs = inputSchema.getAttributes(true);
     size_t const nInputAttrs = attrs.size();
 
     _inputTypes.resize(nInputAttrs);
     _inputArrowBuilders.resize(nInputAttrs);
+    _columnAppenders.resize(nInputAttrs);
     std::vector<std::shared_ptr<arrow::Field>> arrowFields(nInputAttrs);
 
     size_t i = 0;
@@ -165,25 +859,106 @@ void FeatherInterface::setInputSchema(ArrayDesc const& inputSchema)
         switch (scidbType) {
         case TE_BINARY: {
             arrowType = arrow::binary();
+            _columnAppenders[i] = &FeatherInterface::appendBinaryColumn;
+            break;
+        }
+        case TE_BOOL: {
+            // bit-packed by the builder
+            arrowType = arrow::boolean();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::BooleanBuilder, bool>;
+            break;
+        }
+        case TE_CHAR: {
+            arrowType = arrow::utf8();
+            _columnAppenders[i] = &FeatherInterface::appendCharColumn;
+            break;
+        }
+        case TE_DATETIME: {
+            arrowType = arrow::timestamp(arrow::TimeUnit::SECOND);
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::TimestampBuilder, int64_t>;
+            break;
+        }
+        case TE_DATETIMETZ: {
+            arrowType = arrow::timestamp(arrow::TimeUnit::SECOND, "UTC");
+            _columnAppenders[i] = &FeatherInterface::appendDateTimeTzColumn;
             break;
         }
         case TE_DOUBLE: {
             arrowType = arrow::float64();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::DoubleBuilder, double>;
+            break;
+        }
+        case TE_FLOAT: {
+            arrowType = arrow::float32();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::FloatBuilder, float>;
+            break;
+        }
+        case TE_INT8: {
+            arrowType = arrow::int8();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::Int8Builder, int8_t>;
+            break;
+        }
+        case TE_INT16: {
+            arrowType = arrow::int16();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::Int16Builder, int16_t>;
+            break;
+        }
+        case TE_INT32: {
+            arrowType = arrow::int32();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::Int32Builder, int32_t>;
             break;
         }
         case TE_INT64: {
             arrowType = arrow::int64();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::Int64Builder, int64_t>;
             break;
         }
         case TE_STRING: {
             arrowType = arrow::utf8();
+            _columnAppenders[i] = &FeatherInterface::appendStringColumn;
+            break;
+        }
+        case TE_UINT8: {
+            arrowType = arrow::uint8();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::UInt8Builder, uint8_t>;
+            break;
+        }
+        case TE_UINT16: {
+            arrowType = arrow::uint16();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::UInt16Builder, uint16_t>;
+            break;
+        }
+        case TE_UINT32: {
+            arrowType = arrow::uint32();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::UInt32Builder, uint32_t>;
+            break;
+        }
+        case TE_UINT64: {
+            arrowType = arrow::uint64();
+            _columnAppenders[i] = &FeatherInterface::appendNumericColumn<arrow::UInt64Builder, uint64_t>;
             break;
         }
         default: {
-            std::ostringstream error;
-            error << "Type " << scidbType << " not supported by Stream plug-in";
-            throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
-                                   SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+            // UDTs pass through as their bytes: fixed-size binary for a fixed size, binary otherwise
+            Type const& udt = TypeLibrary::getType(inputType);
+            if (udt.variableSize())
+            {
+                arrowType = arrow::binary();
+                _columnAppenders[i] = &FeatherInterface::appendBinaryColumn;
+                _inputTypes[i] = TE_BINARY;
+            }
+            else if (udt.byteSize() > 0)
+            {
+                arrowType = arrow::fixed_size_binary((int32_t) udt.byteSize());
+                _columnAppenders[i] = &FeatherInterface::appendFixedSizeBinaryColumn;
+            }
+            else
+            {
+                std::ostringstream error;
+                error << "Type " << inputType << " not supported by Stream plug-in";
+                throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                                       SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+            }
         }
         }
         arrowFields[i] = arrow::field(
@@ -196,36 +971,123 @@ void FeatherInterface::setInputSchema(ArrayDesc const& inputSchema)
     }
 
     _inputArrowSchema = arrow::schema(arrowFields);
+    ASSIGN_OR_THROW(_inputSchemaMessage, arrow::ipc::SerializeSchema(*_inputArrowSchema, _arrowPool));
+    _sentSchema.reset();
+    _schemaEncoded = false;
 }
 
-void FeatherInterface::streamData(
-    std::vector<ConstChunk const*> const& inputChunks,
-    ChildProcess& child)
+size_t FeatherInterface::checkInputChunks(
+    std::vector<ConstChunk const*> const& inputChunks)
 {
     if(inputChunks.size() != _inputTypes.size())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
           << "received inconsistent number of input chunks";
     }
-    size_t numRows = inputChunks[0]->count();
+    _mask.clear();
+    size_t numRows = _sampler ? _sampler->maskChunk(*inputChunks[0], _mask) : inputChunks[0]->count();
+    if(numRows > (size_t) std::numeric_limits<int32_t>::max())
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+          << "received chunk with count exceeding the Arrow array limit";
+    }
+    return numRows;
+}
+
+void FeatherInterface::streamData(
+    std::vector<ConstChunk const*> const& inputChunks,
+    ChildProcess& child)
+{
+    size_t numRows = checkInputChunks(inputChunks);
     if(numRows == 0)
     {
         return;
     }
-    if(numRows > (size_t) std::numeric_limits<int32_t>::max())
+    if(!child.isAlive())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
-          << "received chunk with count exceeding the Arrow array limit";
+          << "child exited early";
     }
+    THROW_NOT_OK(writeFeather(inputChunks, numRows, child, _sentSchema));
+    readFeather(child);
+}
+
+bool FeatherInterface::encodeData(
+    std::vector<ConstChunk const*> const& inputChunks,
+    MessageRecorder& recorder)
+{
+    size_t numRows = checkInputChunks(inputChunks);
+    if(numRows == 0)
+    {
+        return false;
+    }
+    // The first message carries the schema, so that a cached sequence of messages can be read on its own, and so
+    // does any message with dictionaries, so that it can be read after any other
+    std::shared_ptr<arrow::Schema> receiverSchema;
+    if (_schemaEncoded)
+    {
+        receiverSchema = _inputArrowSchema;
+    }
+    THROW_NOT_OK(writeFeather(inputChunks, numRows, recorder, receiverSchema));
+    _schemaEncoded = true;
+    return true;
+}
+
+void FeatherInterface::streamEncoded(
+    std::vector<char> const& message,
+    ChildProcess& child)
+{
     if(!child.isAlive())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
           << "child exited early";
     }
-    THROW_NOT_OK(writeFeather(inputChunks, numRows, child));
+    // A cached message may come from another session. One that starts with a schema sets the schema of the child,
+    // and the schema of the input goes ahead of any other unless the child has it.
+    uint64_t const bodySize = message.size() - sizeof(uint64_t);
+    arrow::io::BufferReader bodyReader(
+        std::make_shared<arrow::Buffer>((uint8_t const*) message.data() + sizeof(uint64_t), bodySize));
+    std::unique_ptr<arrow::ipc::Message> first;
+    ASSIGN_OR_THROW(first, arrow::ipc::ReadMessage(&bodyReader));
+    if (first != NULL && first->type() == arrow::ipc::MessageType::SCHEMA)
+    {
+        arrow::ipc::DictionaryMemo dictionaries;
+        ASSIGN_OR_THROW(_sentSchema, arrow::ipc::ReadSchema(*first, &dictionaries));
+        child.hardWrite(message.data(), message.size());
+    }
+    else if (_sentSchema != NULL && _sentSchema->Equals(*_inputArrowSchema))
+    {
+        child.hardWrite(message.data(), message.size());
+    }
+    else
+    {
+        uint64_t const writeSize = _inputSchemaMessage->size() + bodySize;
+        _message.append(&writeSize, sizeof(uint64_t));
+        _message.appendRef(_inputSchemaMessage->data(), _inputSchemaMessage->size());
+        _message.appendRef(message.data() + sizeof(uint64_t), bodySize);
+        _message.flush(child);
+        _sentSchema = _inputArrowSchema;
+    }
     readFeather(child);
 }
 
+void FeatherInterface::readResponse(ChildProcess& child)
+{
+    // A replayed response may come from another session; it is decoded on its own, against its own schema or the
+    // one implied by the output types, and the stream of the child goes on afterwards as if it had not been there
+    std::shared_ptr<arrow::Buffer> const childSchemaMessage = _outputSchemaMessage;
+    std::shared_ptr<arrow::ipc::RecordBatchStreamReader> const childBatchReader = _batchReader;
+    ResponseMessageReader* const childResponses = _responses;
+    bool const childDictionariesRead = _dictionariesRead;
+    _outputSchemaMessage = _declaredSchemaMessage;
+    _batchReader.reset();
+    readFeather(child);
+    _outputSchemaMessage = childSchemaMessage;
+    _batchReader = childBatchReader;
+    _responses = childResponses;
+    _dictionariesRead = childDictionariesRead;
+}
+
 shared_ptr<Array> FeatherInterface::finalize(ChildProcess& child)
 {
     writeFinalFeather(child);
@@ -234,9 +1096,11 @@ shared_ptr<Array> FeatherInterface::finalize(ChildProcess& child)
     return _result;
 }
 
+template <class OUTPUT>
 arrow::Status FeatherInterface::writeFeather(vector<ConstChunk const*> const& chunks,
                                     int32_t const numRows,
-                                    ChildProcess& child)
+                                    OUTPUT& out,
+                                    std::shared_ptr<arrow::Schema>& receiverSchema)
 {
     size_t numColumns = chunks.size();
     if (numColumns != _inputTypes.size()) {
@@ -252,133 +1116,88 @@ arrow::Status FeatherInterface::writeFeather(vector<ConstChunk const*> const& ch
                   << ", numRows: " << numRows);
 
     std::vector<std::shared_ptr<arrow::Array>> arrowArrays(numColumns);
+    std::vector<std::shared_ptr<arrow::Field>> dictionaryFields;
     for(size_t i = 0; i < numColumns; ++i)
     {
         shared_ptr<ConstChunkIterator> citer =
             chunks[i]->getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
-
-        auto scidbType = _inputTypes[i];
-        switch(scidbType)
-        {
-        case TE_INT64:
+        if (_inputTypes[i] == TE_STRING &&
+            DictionaryProbe::useDictionary(_dictionaryEncoding, *chunks[i]))
         {
-            while((!citer->end()))
+            // a fresh builder, so that the dictionary holds the strings of this chunk only
+            arrow::StringDictionary32Builder builder(_arrowPool);
+            ARROW_RETURN_NOT_OK(appendDictionaryColumn(*citer, builder, numRows));
+            ARROW_RETURN_NOT_OK(builder.Finish(&arrowArrays[i]));
+            if (dictionaryFields.empty())
             {
-                Value const& value = citer->getItem();
-                if(value.isNull())
-                {
-                    _inputArrowBuilders[i]->AppendNull();
-                }
-                else
-                {
-                    static_cast<arrow::Int64Builder*>(
-                        _inputArrowBuilders[i].get())->Append(value.getInt64());
-                }
-                ++(*citer);
+                dictionaryFields = _inputArrowSchema->fields();
             }
-            break;
+            dictionaryFields[i] = dictionaryFields[i]->WithType(arrowArrays[i]->type());
+            continue;
         }
-        case TE_DOUBLE:
+        if (_inputTypes[i] == TE_STRING || _inputTypes[i] == TE_BINARY)
         {
-            while((!citer->end()))
-            {
-                Value const& value = citer->getItem();
-                if(value.isNull())
-                {
-                    _inputArrowBuilders[i]->AppendNull();
-                }
-                else
-                {
-                    static_cast<arrow::DoubleBuilder*>(
-                        _inputArrowBuilders[i].get())->Append(value.getDouble());
-                }
-                ++(*citer);
-            }
-            break;
+            // the chunk payload bounds the size of the values
+            ARROW_RETURN_NOT_OK(static_cast<arrow::BinaryBuilder&>(*_inputArrowBuilders[i]).ReserveData(
+                chunks[i]->getSize()));
         }
-        case TE_STRING:
-        {
-            while((!citer->end()))
-            {
-                Value const& value = citer->getItem();
-                if(value.isNull())
-                {
-                    _inputArrowBuilders[i]->AppendNull();
-                }
-                else
-                {
-                    static_cast<arrow::StringBuilder*>(
-                        _inputArrowBuilders[i].get())->Append(value.getString());
-                }
-                ++(*citer);
-            }
-            break;
-        }
-        case TE_BINARY:
-        {
-            while((!citer->end()))
-            {
-                Value const& value = citer->getItem();
-                if(value.isNull())
-                {
-                    _inputArrowBuilders[i]->AppendNull();
-                }
-                else
-                {
-                    static_cast<arrow::BinaryBuilder*>(
-                        _inputArrowBuilders[i].get())->Append(
-                            (const uint8_t*)value.data(), value.size());
-                }
-                ++(*citer);
-            }
-            break;
-        }
-        default:
-        {
-            std::ostringstream error;
-            error << "Type " << scidbType << " not supported by Stream plug-in";
-            throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
-                                   SCIDB_LE_ILLEGAL_OPERATION) << error.str();
-        }
-        }
-    }
 
-    // Finalize Arrow Builders and write Arrow Arrays (resets builders)
-    for (size_t i = 0; i < numColumns; ++i)
-        // Resets Builder!
-        THROW_NOT_OK(_inputArrowBuilders[i]->Finish(&arrowArrays[i]));
+        ARROW_RETURN_NOT_OK((this->*_columnAppenders[i])(
+            *citer, *_inputArrowBuilders[i], numRows));
+
+        // Finalize Arrow Builder and write Arrow Array (resets builder)
+        ARROW_RETURN_NOT_OK(_inputArrowBuilders[i]->Finish(&arrowArrays[i]));
+    }
 
     // Create Arrow Record Batch
+    std::shared_ptr<arrow::Schema> const batchSchema =
+        dictionaryFields.empty() ? _inputArrowSchema : arrow::schema(dictionaryFields);
     std::shared_ptr<arrow::RecordBatch> arrowBatch;
     arrowBatch = arrow::RecordBatch::Make(
-        _inputArrowSchema, numRows, arrowArrays);
+        batchSchema, numRows, arrowArrays);
     ARROW_RETURN_NOT_OK(arrowBatch->Validate());
 
-    // Stream Arrow Record Batch to Arrow Buffer using Arrow
-    // Record Batch Writer and Arrow Buffer Output Stream
-    std::shared_ptr<arrow::io::BufferOutputStream> arrowBufferStream;
-    ARROW_ASSIGN_OR_RAISE(
-        arrowBufferStream,
-        // TODO Better initial estimate for Create
-        arrow::io::BufferOutputStream::Create(4096, _arrowPool));
-
-    // Setup Arrow Compression, If Enabled
-    std::shared_ptr<arrow::ipc::RecordBatchWriter> arrowWriter;
-    ASSIGN_OR_THROW(
-        arrowWriter,
-        arrow::ipc::MakeStreamWriter(&*arrowBufferStream, _inputArrowSchema));
-
-    ARROW_RETURN_NOT_OK(arrowWriter->WriteRecordBatch(*arrowBatch));
-    ARROW_RETURN_NOT_OK(arrowWriter->Close());
-
-    std::shared_ptr<arrow::Buffer> arrowBuffer;
-    ARROW_ASSIGN_OR_RAISE(arrowBuffer, arrowBufferStream->Finish());
+    // Serialize the schema, if the receiver does not have it, and the Record Batch into the write buffer
+    bool const withSchema = receiverSchema == NULL || !receiverSchema->Equals(*batchSchema);
+    ArenaOutputStream arrowBufferStream(_writeBuf);
+    int64_t start = 0;
+    if (dictionaryFields.empty())
+    {
+        // sized for both up front
+        int64_t batchSize;
+        ARROW_RETURN_NOT_OK(arrow::ipc::GetRecordBatchSize(*arrowBatch, &batchSize));
+        _writeBuf.reserve((withSchema ? _inputSchemaMessage->size() : 0) + batchSize);
+        if (withSchema)
+        {
+            ARROW_RETURN_NOT_OK(arrowBufferStream.Write(_inputSchemaMessage->data(), _inputSchemaMessage->size()));
+        }
+        ARROW_RETURN_NOT_OK(arrow::ipc::SerializeRecordBatch(
+            *arrowBatch, _ipcWriteOptions, &arrowBufferStream));
+    }
+    else
+    {
+        // The dictionaries go in their own messages ahead of the Record Batch, written by a stream writer that
+        // starts with the schema; the schema is skipped when the receiver has it
+        std::shared_ptr<arrow::ipc::RecordBatchWriter> arrowWriter;
+        ARROW_ASSIGN_OR_RAISE(arrowWriter,
+                              arrow::ipc::MakeStreamWriter(&arrowBufferStream, batchSchema, _ipcWriteOptions));
+        ARROW_RETURN_NOT_OK(arrowWriter->WriteRecordBatch(*arrowBatch));
+        if (!withSchema)
+        {
+            arrow::io::BufferReader schemaReader(
+                std::make_shared<arrow::Buffer>((uint8_t const*) _writeBuf.data(), _writeBuf.size()));
+            ARROW_RETURN_NOT_OK(arrow::ipc::ReadMessage(&schemaReader).status());
+            ARROW_ASSIGN_OR_RAISE(start, schemaReader.Tell());
+        }
+    }
+    receiverSchema = batchSchema;
 
-    uint64_t writeSize = arrowBuffer->size();
+    uint64_t writeSize = _writeBuf.size() - start;
     LOG4CXX_DEBUG(logger, "stream|" << _query->getInstanceID()
                   << "|write|writeSize: " << writeSize);
-    child.hardWrite(&writeSize, sizeof(uint64_t));
-    child.hardWrite(arrowBuffer->data(), writeSize);
+    _message.append(&writeSize, sizeof(uint64_t));
+    _message.appendRef(_writeBuf, start, writeSize);
+    _message.flush(out);
 
     return arrow::Status::OK();
 }
@@ -395,42 +1214,90 @@ void FeatherInterface::readFeather(ChildProcess& child, bool lastMessage)
 {
     uint64_t readSize;
     child.hardRead(&readSize, sizeof(uint64_t), !lastMessage);
+    if (readSize & STOP_FLAG)
+    {
+        _stopRequested = true;
+        readSize &= ~STOP_FLAG;
+    }
     LOG4CXX_DEBUG(logger, "stream|" << _query->getInstanceID()
-                  << "|read|readSize: " << readSize);
+                  << "|read|readSize: " << readSize
+                  << ", stop: " << _stopRequested);
     if (readSize == 0)
     {
         return;
     }
 
-    if (readSize > _readBuf.size())
+    if (_readBuf.capacity() > READ_BUF_SIZE && readSize <= READ_BUF_SIZE)
     {
-        _readBuf.resize(readSize);
+        // give the buffer of an earlier large response back to the arena
+        _readBuf = _arena.acquire(READ_BUF_SIZE);
     }
-    child.hardRead(&(_readBuf[0]), readSize, !lastMessage);
+    // read straight into the aligned buffer, with a spare byte to terminate a string in place
+    _readBuf.reserve(readSize + 1);
+    _readBuf.resize(readSize);
+    child.hardRead(_readBuf.data(), readSize, !lastMessage);
 
-    arrow::Buffer arrowBuffer(&(_readBuf[0]), readSize);
-    auto arrowBufferReader = std::make_shared<arrow::io::BufferReader>(
-            arrowBuffer);
-
-    std::shared_ptr<arrow::RecordBatchReader> arrowBatchReader;
-    ASSIGN_OR_THROW(
-            arrowBatchReader,
-            arrow::ipc::RecordBatchStreamReader::Open(arrowBufferReader));
+    // A response that starts with a schema starts a new stream from the child; the schema is kept for the streams
+    // that come after a response without a batch, which the record batch reader cannot go on from
+    std::shared_ptr<arrow::Buffer> response =
+        std::make_shared<arrow::Buffer>((uint8_t const*) _readBuf.data(), readSize);
+    arrow::io::BufferReader schemaReader(response);
+    std::unique_ptr<arrow::ipc::Message> first;
+    ASSIGN_OR_THROW(first, arrow::ipc::ReadMessage(&schemaReader));
+    if (first != NULL && first->type() == arrow::ipc::MessageType::SCHEMA)
+    {
+        int64_t schemaSize;
+        ASSIGN_OR_THROW(schemaSize, schemaReader.Tell());
+        ASSIGN_OR_THROW(_outputSchemaMessage, response->CopySlice(0, schemaSize));
+        response = arrow::SliceBuffer(response, schemaSize);
+        _batchReader.reset();
+        _responseCacheable = true;
+    }
+    else
+    {
+        // a response that goes on from a schema of the child can only be replayed against that schema
+        _responseCacheable = _outputSchemaMessage->Equals(*_declaredSchemaMessage);
+    }
+    if (_batchReader == NULL)
+    {
+        _responses = new ResponseMessageReader();
+        _responses->setResponse(response, _outputSchemaMessage);
+        ASSIGN_OR_THROW(_batchReader, arrow::ipc::RecordBatchStreamReader::Open(
+                            std::unique_ptr<arrow::ipc::MessageReader>(_responses)));
+        _dictionariesRead = false;
+    }
+    else
+    {
+        _responses->setResponse(response, NULL);
+    }
 
+    // Read the record batches of the response one at a time, each into its own output chunk, up to the end of the
+    // response
     std::shared_ptr<arrow::RecordBatch> arrowBatch;
-    THROW_NOT_OK(arrowBatchReader->ReadNext(&arrowBatch));
-
-    // No More Record Batches are Expected
-    std::shared_ptr<arrow::RecordBatch> arrowBatchNext;
-    THROW_NOT_OK(arrowBatchReader->ReadNext(&arrowBatchNext));
-    if (arrowBatchNext != NULL)
-        throw SYSTEM_EXCEPTION(
-            SCIDB_SE_ARRAY_WRITER,
-            SCIDB_LE_UNKNOWN_ERROR)
-            << "More than one Arrow Record Batch found in response from client";
-
-    int64_t numColumns = arrowBatch->num_columns();
-    int64_t numRows = arrowBatch->num_rows();
+    THROW_NOT_OK(_batchReader->ReadNext(&arrowBatch));
+    if (arrowBatch == NULL)
+    {
+        if (!_dictionariesRead)
+        {
+            _batchReader.reset();
+        }
+        return;
+    }
+    _dictionariesRead = true;
+    do
+    {
+        // a response read with the schema of another stream does not fit its buffers
+        THROW_NOT_OK(arrowBatch->Validate());
+        readRecordBatch(*arrowBatch);
+        THROW_NOT_OK(_batchReader->ReadNext(&arrowBatch));
+    }
+    while (arrowBatch != NULL);
+}
+
+void FeatherInterface::readRecordBatch(arrow::RecordBatch const& arrowBatch)
+{
+    int64_t numColumns = arrowBatch.num_columns();
+    int64_t numRows = arrowBatch.num_rows();
     LOG4CXX_DEBUG(logger, "stream|" << _query->getInstanceID()
                   << "|read|numColumns:" << numColumns
                   << ", numRows:" << numRows);
@@ -445,112 +1312,20 @@ void FeatherInterface::readFeather(ChildProcess& child, bool lastMessage)
         return;
     }
 
-    std::shared_ptr<arrow::ChunkedArray> col;
     for(int64_t i = 0; i < numColumns; ++i)
     {
-        std::shared_ptr<arrow::Array> array = arrowBatch->column(i);
-        int64_t nullCount = array->null_count();
-        const uint8_t* nullBitmap = array->null_bitmap_data();
-
         shared_ptr<ChunkIterator> ociter = _oaiters[i]->newChunk(
             _outPos).getIterator(_query,
                                  ChunkIterator::SEQUENTIAL_WRITE
                                  | ChunkIterator::NO_EMPTY_CHECK);
-        Coordinates valPos = _outPos;
-
-        switch(_outputTypes[i])
+        arrow::Array const& column = *arrowBatch.column(i);
+        if (column.type_id() == arrow::Type::DICTIONARY)
         {
-        case TE_INT64:
-        {
-            const int64_t* arrayData =
-                arrowBatch->column_data(i)->GetValues<int64_t>(1);
-
-            for(int64_t j = 0; j < numRows; ++j)
-            {
-                ociter->setPosition(valPos);
-                if (nullCount != 0 && ! (nullBitmap[j / 8] & 1 << j % 8))
-                {
-                    ociter->writeItem(_nullVal);
-                }
-                else
-                {
-                    _val.setInt64(arrayData[j]);
-                    ociter->writeItem(_val);
-                }
-                ++valPos[2];
-            }
-            break;
+            readDictionaryColumn(column, *ociter, _outputTypes[i]);
         }
-        case TE_DOUBLE:
+        else
         {
-            const double* arrayData =
-                arrowBatch->column_data(i)->GetValues<double>(1);
-
-            for(int64_t j = 0; j < numRows; ++j)
-            {
-                ociter->setPosition(valPos);
-                if (nullCount != 0 && ! (nullBitmap[j / 8] & 1 << j % 8))
-                {
-                    ociter->writeItem(_nullVal);
-                }
-                else
-                {
-                    _val.setDouble(arrayData[j]);
-                    ociter->writeItem(_val);
-                }
-                ++valPos[2];
-            }
-            break;
-        }
-        case TE_STRING:
-        {
-            std::shared_ptr<arrow::StringArray> arrayString =
-                std::static_pointer_cast<arrow::StringArray>(array);
-
-            for(int64_t j = 0; j < numRows; ++j)
-            {
-                ociter->setPosition(valPos);
-                if (nullCount != 0 && ! (nullBitmap[j / 8] & 1 << j % 8))
-                {
-                    ociter->writeItem(_nullVal);
-                }
-                else
-                {
-                    // Strings in Arrow arrays are not null-terminated
-                    _val.setString(arrayString->GetString(j));
-                    ociter->writeItem(_val);
-                }
-                ++valPos[2];
-            }
-            break;
-        }
-        case TE_BINARY:
-        {
-            std::shared_ptr<arrow::BinaryArray> arrayBinary =
-                std::static_pointer_cast<arrow::BinaryArray>(array);
-
-            for(int64_t j = 0; j < numRows; ++j)
-            {
-                ociter->setPosition(valPos);
-                if (nullCount != 0 && ! (nullBitmap[j / 8] & 1 << j % 8))
-                {
-                    ociter->writeItem(_nullVal);
-                }
-                else
-                {
-                    const uint8_t* ptr_val;
-                    int32_t sz_val;
-                    ptr_val = arrayBinary->GetValue(j, &sz_val);
-                    _val.setData(ptr_val, sz_val);
-                    ociter->writeItem(_val);
-                }
-                ++valPos[2];
-            }
-            break;
-        }
-        default: throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL,
-                                        SCIDB_LE_ILLEGAL_OPERATION)
-            << "internal error: unknown type";
+            (this->*_columnReaders[i])(column, *ociter);
         }
         ociter->flush();
     }
@@ -562,12 +1337,10 @@ void FeatherInterface::readFeather(ChildProcess& child, bool lastMessage)
         _outPos).getIterator(_query,
                              ChunkIterator::SEQUENTIAL_WRITE
                              | ChunkIterator::NO_EMPTY_CHECK);
-    Coordinates valPos = _outPos;
-    for(int64_t j =0; j<numRows; ++j)
+    bmCiter->setPosition(_outPos);
+    for(int64_t j =0; j<numRows; ++j, ++(*bmCiter))
     {
-        bmCiter->setPosition(valPos);
         bmCiter->writeItem(bmVal);
-        ++valPos[2];
     }
     bmCiter->flush();
     _outPos[1]++;
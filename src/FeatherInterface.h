@@ -28,21 +28,41 @@
 
 #include <query/PhysicalOperator.h>
 #include <query/TypeSystem.h>
+#include "BufferArena.h"
+#include "MessageBuilder.h"
+#include "DictionaryProbe.h"
 
 #include <arrow/api.h>
+#include <arrow/ipc/options.h>
+#include <arrow/ipc/reader.h>
 
 namespace scidb { namespace stream
 {
 
 class Settings;
 class ChildProcess;
+class MessageRecorder;
+class Sampler;
+class ResponseMessageReader;
 
 /**
  * Interface for streaming data in Feather format. Converts SciDB data to Feather and then communicates with the child process.
  *
  * An empty message contains an empty Feather structure.
  *
- * For UDTs we do attempt to locate a UDT->string conversion function.
+ * Each direction is one Arrow IPC stream for the whole session, cut into size-prefixed messages: the schema goes
+ * with the first message, and again after the input schema changes, and the other messages carry only record
+ * batches. A schema message is accepted in any response, so a child that sends a complete stream every time works.
+ * A response may hold any number of record batches; each one is decoded into its own output chunk.
+ *
+ * With the dictionary setting, string columns are sent as Arrow dictionaries, and the schema of a message that
+ * differs from the previous one goes with it. Dictionary columns in responses are accepted for string and binary
+ * output.
+ *
+ * Every SciDB scalar type has a native Arrow type: bool is bit-packed, datetime is a timestamp in seconds, datetimetz
+ * a timestamp in UTC and char a string of at most one character. Numeric columns in responses convert to any numeric
+ * output type. UDTs are sent as fixed-size binary of their size, or as binary if their size varies, and come back
+ * as binary.
  */
 class FeatherInterface
 {
@@ -64,15 +84,27 @@ public:
      * @param settings the settings of the operator
      * @param outputSchema must be the result of a previous getOutputSchema call for these settings
      * @param query the query context
+     * @param arena the session buffer arena to draw read buffers from; must outlive the interface
      */
-    FeatherInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query);
+    FeatherInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query,
+                     BufferArena& arena);
 
     /**
      * Set the interface to stream chunks from a given array. Must be called before streamData, when first
      * starting to stream and whenever the array that chunks are streamed from changes
      * @param inputSchema the schema of the array whose chunks will be streamed
+     * @param sampler if not NULL, only the cells it keeps are streamed; must outlive the streaming of the array
+     */
+    void setInputSchema(ArrayDesc const& inputSchema, Sampler const* sampler = NULL);
+
+    /**
+     * @return what the result cache must know of the input schema besides the messages: the serialized Arrow schema,
+     * which goes only with the first message
      */
-    void setInputSchema(ArrayDesc const& inputSchema);
+    std::string getInputSchemaKey() const
+    {
+        return std::string((char const*) _inputSchemaMessage->data(), _inputSchemaMessage->size());
+    }
 
     /**
      * Write data to the child and record the response into an internal array.
@@ -82,6 +114,48 @@ public:
      */
     void streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child);
 
+    /**
+     * Encode the message that streamData would send for the given chunks, without sending it or reading a response.
+     * @param inputChunks the data must match the attributes from the most recent setInputSchema call,
+     *                    excluding the empty tag.
+     * @param recorder the destination of the encoded message
+     * @return false if the chunks are empty and there is no message to send
+     */
+    bool encodeData(std::vector<ConstChunk const*> const& inputChunks, MessageRecorder& recorder);
+
+    /**
+     * Write a message previously produced by encodeData to the child and record the response into an internal array.
+     * @param message the encoded message, for the attributes of the most recent setInputSchema call
+     * @param child the process to stream to
+     */
+    void streamEncoded(std::vector<char> const& message, ChildProcess& child);
+
+    /**
+     * Read a response replayed by the child from the result cache into the internal array. The response is decoded
+     * against the schema it starts with, or else the one implied by the output types, and leaves the state of the
+     * stream from the child as it was.
+     * @param child the process to read from
+     */
+    void readResponse(ChildProcess& child);
+
+    /**
+     * @return false if the last response read from the child can't be decoded on its own, because it has no schema
+     * and goes on from a schema the child sent earlier that differs from the one implied by the output types; such
+     * a response must not be cached
+     */
+    bool isResponseCacheable() const
+    {
+        return _responseCacheable;
+    }
+
+    /**
+     * @return true if a response from the child asked not to be sent any more data
+     */
+    bool isStopRequested() const
+    {
+        return _stopRequested;
+    }
+
     /**
      * Finish the interaction, write the terminating message to the child and return a pointer to the array
      * containing all the accumulated result data. This object is invalidated after this call.
@@ -92,7 +166,20 @@ public:
 
     static size_t const MAX_RESPONSE_SIZE = 1024*1024*1024;
 
+    /**
+     * Set in the size that precedes a response to ask not to be sent any more data.
+     */
+    static uint64_t const STOP_FLAG = 1ULL << 63;
+
+    /**
+     * The environment variable that gives the child the codec of the compression setting, if any, so that it can
+     * compress its responses the same way.
+     */
+    static char const* const COMPRESSION_ENV_VAR;
+
 private:
+    static size_t const READ_BUF_SIZE = 1024*1024;
+
     std::shared_ptr<Query>                      _query;
     std::shared_ptr<Array>                      _result;
     Coordinates                                 _outPos;
@@ -100,22 +187,75 @@ private:
     int32_t                                     _nOutputAttrs;
     std::vector<std::shared_ptr<ArrayIterator>> _oaiters;
     const std::vector <TypeEnum>                _outputTypes;
-    std::vector<uint8_t>                        _readBuf;
+    BufferArena&                                _arena;
+    BufferArena::Buffer                         _readBuf;
+    BufferArena::Buffer                         _writeBuf;
+    MessageBuilder                              _message;
     Value                                       _val;
     Value                                       _nullVal;
+    std::string                                 _scratch;
+    std::vector<Value>                          _dictionaryValues;
+    std::vector<char>                           _dictionaryCached;
+    DictionaryEncoding                          _dictionaryEncoding;
     std::vector<TypeEnum>                       _inputTypes;
+    Sampler const*                              _sampler;
+    std::vector<char>                           _mask;
+    bool                                        _stopRequested;
 
     std::shared_ptr<arrow::Schema>                    _inputArrowSchema;
+    std::shared_ptr<arrow::Buffer>                    _inputSchemaMessage;
+    std::shared_ptr<arrow::Schema>                    _sentSchema;
+    bool                                              _schemaEncoded;
+    std::shared_ptr<arrow::Buffer>                    _outputSchemaMessage;
+    std::shared_ptr<arrow::Buffer>                    _declaredSchemaMessage;
+    std::shared_ptr<arrow::ipc::RecordBatchStreamReader> _batchReader;
+    ResponseMessageReader*                            _responses;
+    bool                                              _dictionariesRead;
+    bool                                              _responseCacheable;
+    arrow::ipc::IpcWriteOptions                       _ipcWriteOptions;
     std::vector<std::unique_ptr<arrow::ArrayBuilder>> _inputArrowBuilders;
     arrow::MemoryPool*                                _arrowPool =
         arrow::default_memory_pool();
 
+    typedef arrow::Status (FeatherInterface::*ColumnAppender)(
+        ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    typedef void (FeatherInterface::*ColumnReader)(
+        arrow::Array const& array, ChunkIterator& ociter);
+    std::vector<ColumnAppender>                       _columnAppenders;
+    std::vector<ColumnReader>                         _columnReaders;
+
 
+    size_t checkInputChunks(std::vector<ConstChunk const*> const& inputChunks);
+    template <class OUTPUT>
     arrow::Status writeFeather(std::vector<ConstChunk const*> const& chunks,
                                int32_t const numRows,
-                               ChildProcess& child);
+                               OUTPUT& out,
+                               std::shared_ptr<arrow::Schema>& receiverSchema);
     void writeFinalFeather(ChildProcess& child);
     void readFeather(ChildProcess& child, bool lastMessage = false);
+    void readRecordBatch(arrow::RecordBatch const& arrowBatch);
+    template <typename BUILDER, typename SCIDB_T>
+    arrow::Status appendNumericColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    arrow::Status appendStringColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    arrow::Status appendBinaryColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    arrow::Status appendDictionaryColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    arrow::Status appendFixedSizeBinaryColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    arrow::Status appendCharColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    arrow::Status appendDateTimeTzColumn(ConstChunkIterator& citer, arrow::ArrayBuilder& builder, int32_t const numRows);
+    template <typename WRITE_VALUE>
+    void readColumn(arrow::Array const& array, ChunkIterator& ociter, WRITE_VALUE const& writeValue);
+    template <typename ARROW_C_T, typename C_T>
+    void readNumericValues(arrow::Array const& array, ChunkIterator& ociter);
+    template <typename C_T>
+    void readNumericColumn(arrow::Array const& array, ChunkIterator& ociter);
+    template <typename WRITE_SECONDS>
+    void readSeconds(arrow::Array const& array, ChunkIterator& ociter, WRITE_SECONDS const& writeSeconds);
+    void readDateTimeColumn(arrow::Array const& array, ChunkIterator& ociter);
+    void readDateTimeTzColumn(arrow::Array const& array, ChunkIterator& ociter);
+    void readCharColumn(arrow::Array const& array, ChunkIterator& ociter);
+    void readStringColumn(arrow::Array const& array, ChunkIterator& ociter);
+    void readBinaryColumn(arrow::Array const& array, ChunkIterator& ociter);
+    void readDictionaryColumn(arrow::Array const& array, ChunkIterator& ociter, TypeEnum const outputType);
 };
 
 }}
@@ -0,0 +1,256 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "InputCache.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <iomanip>
+#include <limits>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "../extern/MurmurHash/MurmurHash3.h"
+
+namespace scidb { namespace stream {
+
+char const* const InputCache::CACHE_DIR = "/dev/shm/scidb_stream/input";
+
+InputCache::InputCache(ArrayDesc const& schema, Settings const& settings):
+    _dir(CACHE_DIR),
+    _version(schema.getVersionId()),
+    _maxBytes(settings.getInputCacheSize()),
+    _bytesWritten(0),
+    _full(false),
+    _hits(0),
+    _misses(0)
+{
+    ostringstream prefix;
+    prefix<<schema.getUAId()<<"_";
+    _prefix = prefix.str();
+    ostringstream key;
+    key<<std::setprecision(std::numeric_limits<double>::max_digits10);  // tell all sampling probabilities apart
+    key<<"format="<<settings.getFormat()<<";sample="<<settings.getSample()<<";sampleChunks="<<settings.getSampleChunks()<<";seed="<<settings.getSeed()<<";int64AsInteger64="<<settings.isInt64AsInteger64()<<";compression="<<settings.getCompression()<<";dictionary="<<settings.getDictionaryEncoding()<<";attrs=";
+    for (const auto& attr : schema.getAttributes(true))
+    {
+        key<<attr.getName()<<":"<<attr.getType()<<",";
+    }
+    _key = key.str();
+}
+
+string InputCache::getPath(Coordinates const& chunkPos) const
+{
+    ostringstream key;
+    key<<_key<<";pos="<<CoordsToStr(chunkPos);
+    string const keyString = key.str();
+    uint64_t hash[2];
+    MurmurHash3_x64_128(keyString.data(), (int) keyString.size(), 0, hash);
+    char hex[33];
+    snprintf(hex, sizeof(hex), "%016lx%016lx", (unsigned long) hash[0], (unsigned long) hash[1]);
+    ostringstream path;
+    path<<_dir<<"/"<<_prefix<<_version<<"_"<<hex;
+    return path.str();
+}
+
+bool InputCache::readFile(string const& path, vector<char>& data)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    data.resize(st.st_size);
+    size_t bytesRead = 0;
+    while(bytesRead < data.size())
+    {
+        ssize_t ret = ::read(fd, &data[bytesRead], data.size() - bytesRead);
+        if(ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(ret <= 0)
+        {
+            close(fd);
+            return false;
+        }
+        bytesRead += ret;
+    }
+    futimens(fd, NULL); // mark as recently used
+    close(fd);
+    return true;
+}
+
+void InputCache::writeFile(string const& path, vector<char> const& data)
+{
+    string const dir = path.substr(0, path.rfind('/'));
+    string const cacheRoot = dir.substr(0, dir.rfind('/'));
+    if((mkdir(cacheRoot.c_str(), 0700) != 0 && errno != EEXIST) || (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST))
+    {
+        LOG4CXX_DEBUG(logger, "stream could not create cache directory "<<dir<<" errno "<<errno);
+        return;
+    }
+    vector<char> tmpl(path.begin(), path.end());
+    string const suffix(".XXXXXX");
+    tmpl.insert(tmpl.end(), suffix.begin(), suffix.end());
+    tmpl.push_back(0);
+    int fd = mkstemp(&tmpl[0]);
+    if(fd < 0)
+    {
+        LOG4CXX_DEBUG(logger, "stream could not create cache file "<<path<<" errno "<<errno);
+        return;
+    }
+    size_t bytesWritten = 0;
+    while(bytesWritten < data.size())
+    {
+        ssize_t ret = ::write(fd, &data[bytesWritten], data.size() - bytesWritten);
+        if(ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(ret <= 0)
+        {
+            break;
+        }
+        bytesWritten += ret;
+    }
+    close(fd);
+    if(bytesWritten != data.size() || rename(&tmpl[0], path.c_str()) != 0)
+    {
+        // the cache is best effort; e.g. /dev/shm may be full
+        LOG4CXX_DEBUG(logger, "stream could not store cache file "<<path<<" errno "<<errno);
+        unlink(&tmpl[0]);
+    }
+}
+
+void InputCache::trimDirectory(string const& dir, size_t maxBytes)
+{
+    DIR* dirp = opendir(dir.c_str());
+    if(dirp == NULL)
+    {
+        return;
+    }
+    struct Entry
+    {
+        string path;
+        size_t size;
+        time_t mtime;
+    };
+    vector<Entry> entries;
+    size_t totalBytes = 0;
+    while(struct dirent* entry = readdir(dirp))
+    {
+        string const entryName(entry->d_name);
+        if(entryName == "." || entryName == "..")
+        {
+            continue;
+        }
+        string const entryPath = dir + "/" + entryName;
+        struct stat st;
+        if(stat(entryPath.c_str(), &st) == 0)
+        {
+            entries.push_back(Entry{entryPath, (size_t) st.st_size, st.st_mtime});
+            totalBytes += st.st_size;
+        }
+    }
+    closedir(dirp);
+    if(totalBytes <= maxBytes)
+    {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.mtime < b.mtime; });
+    for(size_t i = 0; i<entries.size() && totalBytes > maxBytes; ++i)
+    {
+        if(unlink(entries[i].path.c_str()) == 0)
+        {
+            totalBytes -= entries[i].size;
+        }
+    }
+    LOG4CXX_DEBUG(logger, "stream trimmed cache "<<dir<<" to "<<totalBytes<<" bytes");
+}
+
+bool InputCache::read(Coordinates const& chunkPos, vector<char>& message)
+{
+    if(!readFile(getPath(chunkPos), message))
+    {
+        ++_misses;
+        return false;
+    }
+    ++_hits;
+    return true;
+}
+
+void InputCache::write(Coordinates const& chunkPos, vector<char> const& message)
+{
+    if(_full)
+    {
+        return;
+    }
+    if(_bytesWritten + message.size() > _maxBytes)
+    {
+        LOG4CXX_DEBUG(logger, "stream input cache wrote its limit of "<<_maxBytes<<" bytes, caching no more chunks");
+        _full = true;
+        trim();
+        return;
+    }
+    _bytesWritten += message.size();
+    writeFile(getPath(chunkPos), message);
+}
+
+void InputCache::trim()
+{
+    DIR* dir = opendir(_dir.c_str());
+    if(dir == NULL)
+    {
+        return;
+    }
+    while(struct dirent* entry = readdir(dir))
+    {
+        string const entryName(entry->d_name);
+        if(entryName.compare(0, _prefix.size(), _prefix) != 0)
+        {
+            continue;
+        }
+        char* end = NULL;
+        VersionID const version = strtoull(entryName.c_str() + _prefix.size(), &end, 10);
+        if(*end == '_' && version != _version)
+        {
+            string const entryPath = _dir + "/" + entryName;
+            LOG4CXX_DEBUG(logger, "stream removing stale input cache "<<entryPath);
+            unlink(entryPath.c_str());
+        }
+    }
+    closedir(dir);
+    trimDirectory(_dir, _maxBytes);
+}
+
+}}
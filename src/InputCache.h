@@ -0,0 +1,120 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_INPUTCACHE_H_
+#define SRC_INPUTCACHE_H_
+
+#include <query/PhysicalOperator.h>
+#include "StreamSettings.h"
+
+namespace scidb { namespace stream
+{
+
+/**
+ * A host-wide cache of the encoded messages of a stored input array, one file per chunk position, so that repeated
+ * queries over the same array version send the cached bytes instead of fetching, decompressing and encoding the
+ * chunks again. A file is keyed by the unversioned array id and version, the chunk position, the attribute names and
+ * types, the transfer format and the sampling settings; the key is hashed with MurmurHash3 into the file name.
+ *
+ * Files are published atomically with a rename, so concurrent writers are harmless. Reading a file touches it, and
+ * trim() removes the files of other versions of the array and then the least recently used files until the cache
+ * fits in its size limit. A query stops caching and trims once it has written as many bytes as the limit, so that
+ * a large input can't fill /dev/shm before the query ends.
+ */
+class InputCache
+{
+public:
+    static char const* const CACHE_DIR;
+
+    /**
+     * @param schema the schema of the input array, must be cacheable, see SideInputCache::isCacheable
+     * @param settings the settings of the operator
+     */
+    InputCache(ArrayDesc const& schema, Settings const& settings);
+
+    /**
+     * Read the cached message for a chunk position.
+     * @param chunkPos the position of the chunk
+     * @param[out] message the bytes of the message
+     * @return true if the message was cached
+     */
+    bool read(Coordinates const& chunkPos, std::vector<char>& message);
+
+    /**
+     * Store the message for a chunk position, unless this cache has already written its size limit in messages.
+     * @param chunkPos the position of the chunk
+     * @param message the bytes of the message
+     */
+    void write(Coordinates const& chunkPos, std::vector<char> const& message);
+
+    /**
+     * Remove the files of other versions of the array, then the least recently used files until the cache is no
+     * larger than its limit.
+     */
+    void trim();
+
+    /**
+     * Read a whole cache file and mark it as recently used.
+     * @return false if the file does not exist or could not be read
+     */
+    static bool readFile(std::string const& path, std::vector<char>& data);
+
+    /**
+     * Publish a cache file atomically, creating its directory if needed. Failures are logged and ignored.
+     */
+    static void writeFile(std::string const& path, std::vector<char> const& data);
+
+    /**
+     * Remove the least recently used files in a directory until their total size is no larger than maxBytes.
+     */
+    static void trimDirectory(std::string const& dir, size_t maxBytes);
+
+    size_t getHits() const
+    {
+        return _hits;
+    }
+
+    size_t getMisses() const
+    {
+        return _misses;
+    }
+
+private:
+    std::string _dir;
+    std::string _prefix;
+    VersionID   _version;
+    std::string _key;
+    size_t      _maxBytes;
+    size_t      _bytesWritten;
+    bool        _full;
+    size_t      _hits;
+    size_t      _misses;
+
+    std::string getPath(Coordinates const& chunkPos) const;
+};
+
+}}
+
+#endif /* SRC_INPUTCACHE_H_ */
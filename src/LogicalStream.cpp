@@ -70,6 +70,20 @@ public:
             },
             { KW_FORMAT, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
             { KW_CHUNK_SIZE, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_ZIP, RE(PP(PLACEHOLDER_CONSTANT, TID_BOOL)) },
+            { KW_SIDE_CACHE, RE(PP(PLACEHOLDER_CONSTANT, TID_BOOL)) },
+            { KW_PARTITION_BY, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_ORDERED_BY, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_SAMPLE, RE(PP(PLACEHOLDER_CONSTANT, TID_DOUBLE)) },
+            { KW_SAMPLE_CHUNKS, RE(PP(PLACEHOLDER_CONSTANT, TID_DOUBLE)) },
+            { KW_SEED, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_INPUT_CACHE, RE(PP(PLACEHOLDER_CONSTANT, TID_BOOL)) },
+            { KW_INPUT_CACHE_MB, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_CACHE, RE(PP(PLACEHOLDER_CONSTANT, TID_BOOL)) },
+            { KW_CACHE_MB, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_INT64_AS, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_COMPRESSION, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_DICTIONARY, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
             { KW_TYPES, RE(RE::OR, {
                            RE(PP(PLACEHOLDER_EXPRESSION, TID_STRING)),
                            RE(RE::GROUP, {
@@ -117,13 +131,105 @@ public:
         query->getRights()->upsert(rbac::ET_DB, "", rbac::P_DB_OPS);
     }
 
-    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, shared_ptr<Query> query)
+    /**
+     * In zip mode the chunks of all inputs are walked in lockstep, so all inputs must share the chunking of the first
+     * one: same number of dimensions, same starting coordinates, chunk intervals and overlaps.
+     */
+    void checkZipSchemas(std::vector<ArrayDesc> const& schemas)
     {
-        if(schemas.size() > 2)
+        if(schemas.size() < 2)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "can't support more than two input arrays";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "zip requires at least two input arrays";
         }
+        Dimensions const& leadDims = schemas[0].getDimensions();
+        for(size_t i = 1; i<schemas.size(); ++i)
+        {
+            Dimensions const& dims = schemas[i].getDimensions();
+            if(dims.size() != leadDims.size())
+            {
+                ostringstream error;
+                error<<"zip input "<<i<<" has "<<dims.size()<<" dimensions; expected "<<leadDims.size();
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+            }
+            for(size_t j = 0; j<dims.size(); ++j)
+            {
+                if(dims[j].getStartMin()      != leadDims[j].getStartMin()      ||
+                   dims[j].getChunkInterval() != leadDims[j].getChunkInterval() ||
+                   dims[j].getChunkOverlap()  != leadDims[j].getChunkOverlap())
+                {
+                    ostringstream error;
+                    error<<"zip input "<<i<<" dimension "<<dims[j].getBaseName()<<" is not chunked like the first input";
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+                }
+            }
+        }
+    }
+
+    /**
+     * The partition_by key must be an attribute of the first input.
+     */
+    void checkPartitionKey(ArrayDesc const& schema, string const& key)
+    {
+        for (const auto& attr : schema.getAttributes(true))
+        {
+            if(attr.getName() == key)
+            {
+                return;
+            }
+        }
+        ostringstream error;
+        error<<"partition_by attribute "<<key<<" is not an attribute of the first input";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+    }
+
+    /**
+     * The ordered_by dimension must be a dimension of the first input.
+     */
+    void checkOrderDimension(ArrayDesc const& schema, string const& dim)
+    {
+        for (const auto& dimension : schema.getDimensions())
+        {
+            if(dimension.hasNameAndAlias(dim))
+            {
+                return;
+            }
+        }
+        ostringstream error;
+        error<<"ordered_by dimension "<<dim<<" is not a dimension of the first input";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+    }
+
+    ArrayDesc inferSchema(std::vector<ArrayDesc> schemas, shared_ptr<Query> query)
+    {
         Settings settings(_parameters, _kwParameters, true, query);
+        if(settings.isZip())
+        {
+            checkZipSchemas(schemas);
+            if(settings.isSideCacheEnabled() || settings.isInputCacheEnabled())
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "side_cache and input_cache can't be combined with zip";
+            }
+        }
+        else if(schemas.size() > 2)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "can't support more than two input arrays without zip";
+        }
+        if(!settings.getPartitionBy().empty())
+        {
+            if(settings.isZip())
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "partition_by can't be combined with zip";
+            }
+            checkPartitionKey(schemas[0], settings.getPartitionBy());
+        }
+        if(!settings.getOrderedBy().empty())
+        {
+            if(settings.isZip() || !settings.getPartitionBy().empty())
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "ordered_by can't be combined with zip or partition_by";
+            }
+            checkOrderDimension(schemas[0], settings.getOrderedBy());
+        }
         if(settings.getFormat() == TSV)
         {
             return TSVInterface::getOutputSchema(schemas, settings, query);
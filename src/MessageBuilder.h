@@ -0,0 +1,157 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_MESSAGEBUILDER_H_
+#define SRC_MESSAGEBUILDER_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <vector>
+#include "BufferArena.h"
+
+namespace scidb { namespace stream
+{
+
+/**
+ * Collects the segments of one message - small headers copied into the builder and large bodies referenced where
+ * they already are - and sends them with a single hardWritev, rather than one poll and write per segment. Copied
+ * pieces that follow each other are merged into one segment.
+ */
+class MessageBuilder
+{
+public:
+    MessageBuilder():
+        _size(0)
+    {}
+
+    /**
+     * Copy a small piece of the message, like a header or a count, into the builder.
+     */
+    void append(void const* data, size_t const size)
+    {
+        if(size == 0)
+        {
+            return;
+        }
+        size_t const offset = _scratch.size();
+        _scratch.insert(_scratch.end(), (char const*) data, ((char const*) data) + size);
+        if(_segments.size() && _segments.back().buffer == NULL && _segments.back().data == NULL &&
+           _segments.back().offset + _segments.back().size == offset)
+        {
+            _segments.back().size += size;
+        }
+        else
+        {
+            _segments.push_back(Segment(NULL, NULL, offset, size));
+        }
+        _size += size;
+    }
+
+    /**
+     * Add size bytes at data to the message without copying them. The data must stay in place until flush.
+     */
+    void appendRef(void const* data, size_t const size)
+    {
+        if(size)
+        {
+            _segments.push_back(Segment(NULL, (char const*) data, 0, size));
+            _size += size;
+        }
+    }
+
+    /**
+     * Add size bytes at offset of buffer to the message without copying them. The buffer may grow, and move,
+     * before flush but must not be released.
+     */
+    void appendRef(BufferArena::Buffer const& buffer, size_t const offset, size_t const size)
+    {
+        if(size)
+        {
+            _segments.push_back(Segment(&buffer, NULL, offset, size));
+            _size += size;
+        }
+    }
+
+    /**
+     * @return the number of bytes in the message so far
+     */
+    size_t size() const
+    {
+        return _size;
+    }
+
+    /**
+     * Write the message to out with one hardWritev call and start a new one.
+     */
+    template <class OUTPUT>
+    void flush(OUTPUT& out)
+    {
+        _iov.resize(_segments.size());
+        for(size_t i = 0; i<_segments.size(); ++i)
+        {
+            Segment const& s = _segments[i];
+            char const* base = s.buffer ? s.buffer->data() + s.offset :
+                               s.data   ? s.data :
+                                          _scratch.data() + s.offset;
+            _iov[i].iov_base = const_cast<char*>(base);
+            _iov[i].iov_len  = s.size;
+        }
+        if(_iov.size())
+        {
+            out.hardWritev(_iov.data(), _iov.size());
+        }
+        clear();
+    }
+
+    void clear()
+    {
+        _segments.clear();
+        _scratch.clear();
+        _size = 0;
+    }
+
+private:
+    struct Segment
+    {
+        Segment(BufferArena::Buffer const* b, char const* d, size_t o, size_t s):
+            buffer(b), data(d), offset(o), size(s)
+        {}
+
+        BufferArena::Buffer const* buffer;  // referenced buffer, or
+        char const*                data;    // referenced memory, or the scratch of the builder if both are NULL
+        size_t                     offset;
+        size_t                     size;
+    };
+
+    std::vector<Segment>      _segments;
+    std::vector<char>         _scratch;
+    std::vector<struct iovec> _iov;
+    size_t                    _size;
+};
+
+}}
+
+#endif /* SRC_MESSAGEBUILDER_H_ */
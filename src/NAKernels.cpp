@@ -0,0 +1,259 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "NAKernels.h"
+#include <string.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define STREAM_NA_AVX2 1
+#endif
+
+namespace scidb { namespace stream
+{
+
+namespace
+{
+
+inline int64_t bits(double v)
+{
+    int64_t b;
+    memcpy(&b, &v, sizeof(double));
+    return b;
+}
+
+size_t findNAScalar32(int32_t const* values, size_t n, int32_t na, uint8_t* mask)
+{
+    size_t count = 0;
+    for(size_t i = 0; i<n; ++i)
+    {
+        mask[i] = values[i] == na;
+        count += mask[i];
+    }
+    return count;
+}
+
+size_t findNAScalar64(int64_t const* values, size_t n, int64_t na, uint8_t* mask)
+{
+    size_t count = 0;
+    for(size_t i = 0; i<n; ++i)
+    {
+        mask[i] = values[i] == na;
+        count += mask[i];
+    }
+    return count;
+}
+
+size_t findNaNScalar(double const* values, size_t n, uint8_t* mask)
+{
+    size_t count = 0;
+    for(size_t i = 0; i<n; ++i)
+    {
+        mask[i] = values[i] != values[i];
+        count += mask[i];
+    }
+    return count;
+}
+
+template <typename T>
+void fillNAScalar(T* values, size_t n, T na, uint8_t const* mask)
+{
+    for(size_t i = 0; i<n; ++i)
+    {
+        values[i] = mask[i] ? na : values[i];
+    }
+}
+
+#ifdef STREAM_NA_AVX2
+
+inline void spreadBits(int bits, size_t width, uint8_t* mask)
+{
+    for(size_t k = 0; k<width; ++k)
+    {
+        mask[k] = (bits >> k) & 1;
+    }
+}
+
+__attribute__((target("avx2")))
+size_t findNAAvx2_32(int32_t const* values, size_t n, int32_t na, uint8_t* mask)
+{
+    __m256i const naV = _mm256_set1_epi32(na);
+    size_t count = 0;
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i const v = _mm256_loadu_si256((__m256i const*) (values + i));
+        int const found = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, naV)));
+        spreadBits(found, 8, mask + i);
+        count += __builtin_popcount(found);
+    }
+    return count + findNAScalar32(values + i, n - i, na, mask + i);
+}
+
+__attribute__((target("avx2")))
+size_t findNAAvx2_64(int64_t const* values, size_t n, int64_t na, uint8_t* mask)
+{
+    __m256i const naV = _mm256_set1_epi64x(na);
+    size_t count = 0;
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256i const v = _mm256_loadu_si256((__m256i const*) (values + i));
+        int const found = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, naV)));
+        spreadBits(found, 4, mask + i);
+        count += __builtin_popcount(found);
+    }
+    return count + findNAScalar64(values + i, n - i, na, mask + i);
+}
+
+__attribute__((target("avx2")))
+size_t findNaNAvx2(double const* values, size_t n, uint8_t* mask)
+{
+    size_t count = 0;
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d const v = _mm256_loadu_pd(values + i);
+        int const found = _mm256_movemask_pd(_mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+        spreadBits(found, 4, mask + i);
+        count += __builtin_popcount(found);
+    }
+    return count + findNaNScalar(values + i, n - i, mask + i);
+}
+
+__attribute__((target("avx2")))
+void fillNAAvx2_32(int32_t* values, size_t n, int32_t na, uint8_t const* mask)
+{
+    __m256i const naV = _mm256_set1_epi32(na);
+    __m256i const zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i const m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*) (mask + i)));
+        __m256i const v = _mm256_loadu_si256((__m256i const*) (values + i));
+        _mm256_storeu_si256((__m256i*) (values + i), _mm256_blendv_epi8(v, naV, _mm256_cmpgt_epi32(m, zero)));
+    }
+    fillNAScalar(values + i, n - i, na, mask + i);
+}
+
+__attribute__((target("avx2")))
+void fillNAAvx2_64(int64_t* values, size_t n, int64_t na, uint8_t const* mask)
+{
+    __m256i const naV = _mm256_set1_epi64x(na);
+    __m256i const zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        int32_t m4;
+        memcpy(&m4, mask + i, sizeof(int32_t));
+        __m256i const m = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(m4));
+        __m256i const v = _mm256_loadu_si256((__m256i const*) (values + i));
+        _mm256_storeu_si256((__m256i*) (values + i), _mm256_blendv_epi8(v, naV, _mm256_cmpgt_epi64(m, zero)));
+    }
+    fillNAScalar(values + i, n - i, na, mask + i);
+}
+
+bool const HAS_AVX2 = __builtin_cpu_supports("avx2");
+
+#else
+
+bool const HAS_AVX2 = false;
+
+#endif
+
+} // anonymous namespace
+
+size_t NAKernels::findNA(int32_t const* values, size_t n, int32_t na, bool, uint8_t* mask)
+{
+#ifdef STREAM_NA_AVX2
+    if(HAS_AVX2)
+    {
+        return findNAAvx2_32(values, n, na, mask);
+    }
+#endif
+    return findNAScalar32(values, n, na, mask);
+}
+
+size_t NAKernels::findNA(int64_t const* values, size_t n, int64_t na, bool, uint8_t* mask)
+{
+#ifdef STREAM_NA_AVX2
+    if(HAS_AVX2)
+    {
+        return findNAAvx2_64(values, n, na, mask);
+    }
+#endif
+    return findNAScalar64(values, n, na, mask);
+}
+
+size_t NAKernels::findNA(double const* values, size_t n, double na, bool anyNaN, uint8_t* mask)
+{
+    if(!anyNaN)
+    {
+        // NA_real_ is one NaN payload among many, so compare the bits
+        return findNA(reinterpret_cast<int64_t const*>(values), n, bits(na), false, mask);
+    }
+#ifdef STREAM_NA_AVX2
+    if(HAS_AVX2)
+    {
+        return findNaNAvx2(values, n, mask);
+    }
+#endif
+    return findNaNScalar(values, n, mask);
+}
+
+void NAKernels::fillNA(int32_t* values, size_t n, int32_t na, uint8_t const* mask)
+{
+#ifdef STREAM_NA_AVX2
+    if(HAS_AVX2)
+    {
+        fillNAAvx2_32(values, n, na, mask);
+        return;
+    }
+#endif
+    fillNAScalar(values, n, na, mask);
+}
+
+void NAKernels::fillNA(int64_t* values, size_t n, int64_t na, uint8_t const* mask)
+{
+#ifdef STREAM_NA_AVX2
+    if(HAS_AVX2)
+    {
+        fillNAAvx2_64(values, n, na, mask);
+        return;
+    }
+#endif
+    fillNAScalar(values, n, na, mask);
+}
+
+void NAKernels::fillNA(double* values, size_t n, double na, uint8_t const* mask)
+{
+    fillNA(reinterpret_cast<int64_t*>(values), n, bits(na), mask);
+}
+
+bool NAKernels::isVectorized()
+{
+    return HAS_AVX2;
+}
+
+}}
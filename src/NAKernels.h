@@ -0,0 +1,72 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_NAKERNELS_H_
+#define SRC_NAKERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace scidb { namespace stream
+{
+
+/**
+ * Column kernels that translate between null masks and the NA sentinel values of R: NA_integer_ is INT32_MIN,
+ * NA_real_ is a NaN with a particular payload, and bit64's NA_integer64 is INT64_MIN. The kernels run 4 or 8
+ * values at a time with AVX2 when the CPU has it, chosen once at load time, and fall back to scalar loops
+ * elsewhere. Masks hold one byte per value, nonzero for null.
+ */
+class NAKernels
+{
+public:
+    /**
+     * Mark the values equal to na in mask.
+     * @param values the column
+     * @param n the number of values
+     * @param na the sentinel; doubles are compared bit for bit, so NaN that are not NA stay values
+     * @param anyNaN for doubles, mark every NaN instead of only na; ignored for integers
+     * @param[out] mask n bytes, set to 1 where the value is NA and 0 elsewhere
+     * @return the number of values marked
+     */
+    static size_t findNA(int32_t const* values, size_t n, int32_t na, bool anyNaN, uint8_t* mask);
+    static size_t findNA(int64_t const* values, size_t n, int64_t na, bool anyNaN, uint8_t* mask);
+    static size_t findNA(double const* values, size_t n, double na, bool anyNaN, uint8_t* mask);
+
+    /**
+     * Overwrite the values whose mask byte is nonzero with na.
+     */
+    static void fillNA(int32_t* values, size_t n, int32_t na, uint8_t const* mask);
+    static void fillNA(int64_t* values, size_t n, int64_t na, uint8_t const* mask);
+    static void fillNA(double* values, size_t n, double na, uint8_t const* mask);
+
+    /**
+     * @return true if the AVX2 kernels are in use
+     */
+    static bool isVectorized();
+};
+
+}}
+
+#endif /* SRC_NAKERNELS_H_ */
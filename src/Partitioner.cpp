@@ -0,0 +1,511 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "Partitioner.h"
+#include "StreamSettings.h"
+#include "Sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <array/MemArray.h>
+#include <network/Network.h>
+#include <array/MemoryBuffer.h>
+#include "../extern/MurmurHash/MurmurHash3.h"
+
+namespace scidb { namespace stream {
+
+Partitioner::Partitioner(ArrayDesc const& inputSchema, size_t messageRows, Sampler const* sampler, std::shared_ptr<Query> const& query):
+    _query(query),
+    _inputSchema(inputSchema),
+    _messageRows(messageRows),
+    _sampler(sampler),
+    _nAttrs(inputSchema.getAttributes(true).size()),
+    _nInstances(query->getInstancesCount()),
+    _instanceId(query->getInstanceID())
+{}
+
+size_t Partitioner::findAttribute(string const& name) const
+{
+    size_t i = 0;
+    for (const auto& attr : _inputSchema.getAttributes(true))
+    {
+        if(attr.getName() == name)
+        {
+            return i;
+        }
+        ++i;
+    }
+    ostringstream error;
+    error<<"partition attribute "<<name<<" not found";
+    throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+}
+
+size_t Partitioner::findDimension(string const& name) const
+{
+    Dimensions const& dims = _inputSchema.getDimensions();
+    for(size_t i = 0; i<dims.size(); ++i)
+    {
+        if(dims[i].hasNameAndAlias(name))
+        {
+            return i;
+        }
+    }
+    ostringstream error;
+    error<<"partition dimension "<<name<<" not found";
+    throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+}
+
+/**
+ * The bytes that identify a key value: nulls are told apart from values, but all nulls are equal. Floating point
+ * keys are normalized first, so that 0 and -0, and all NaNs whatever their payload, make one key each.
+ */
+static string keyBytes(Value const& v, TypeEnum type)
+{
+    if(v.isNull())
+    {
+        return string(1, '\0');
+    }
+    string result(1, '\1');
+    if(type == TE_DOUBLE)
+    {
+        double d = v.getDouble();
+        d = std::isnan(d) ? std::numeric_limits<double>::quiet_NaN() : d == 0 ? 0.0 : d;
+        result.append((char const*) &d, sizeof(d));
+    }
+    else if(type == TE_FLOAT)
+    {
+        float f = v.getFloat();
+        f = std::isnan(f) ? std::numeric_limits<float>::quiet_NaN() : f == 0 ? 0.0f : f;
+        result.append((char const*) &f, sizeof(f));
+    }
+    else
+    {
+        result.append((char const*) v.data(), v.size());
+    }
+    return result;
+}
+
+/**
+ * Writes rows into the exchange array as they are produced. The chunks being filled for each destination stay open
+ * until they hold messageRows rows, so at most one chunk per destination and column is held at a time.
+ */
+class ExchangeWriter
+{
+public:
+    ExchangeWriter(shared_ptr<Array>& outgoing, size_t nInstances, InstanceID instanceId, size_t messageRows,
+                   shared_ptr<Query> const& query):
+        _query(query),
+        _messageRows(messageRows),
+        _nColumns(outgoing->getArrayDesc().getAttributes(true).size()),
+        _oaiters(nInstances, vector<shared_ptr<ArrayIterator> >(_nColumns+1)),
+        _citers(nInstances, vector<shared_ptr<ChunkIterator> >(_nColumns+1)),
+        _positions(nInstances)
+    {
+        // an array iterator per destination, each with the chunk it is filling
+        ArrayDesc const& schema = outgoing->getArrayDesc();
+        for(size_t dst = 0; dst<nInstances; ++dst)
+        {
+            size_t i = 0;
+            for (const auto& attr : schema.getAttributes(true))
+            {
+                _oaiters[dst][i++] = outgoing->getIterator(attr);
+            }
+            _oaiters[dst][_nColumns] = outgoing->getIterator(*schema.getEmptyBitmapAttribute());
+            _positions[dst] = Coordinates { (Coordinate) dst, (Coordinate) instanceId, 0 };
+        }
+        _bmVal.setBool(true);
+    }
+
+    /**
+     * Append a row for a destination.
+     * @param getValue returns the value of a column of the row
+     */
+    template <typename GET_VALUE>
+    void append(size_t dst, GET_VALUE const& getValue)
+    {
+        Coordinates& pos = _positions[dst];
+        vector<shared_ptr<ChunkIterator> >& citers = _citers[dst];
+        if(pos[2] % _messageRows == 0)
+        {
+            for(size_t i = 0; i<=_nColumns; ++i)
+            {
+                if(citers[i])
+                {
+                    citers[i]->flush();
+                }
+                citers[i] = _oaiters[dst][i]->newChunk(pos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE | ChunkIterator::NO_EMPTY_CHECK);
+            }
+        }
+        for(size_t i = 0; i<=_nColumns; ++i)
+        {
+            citers[i]->setPosition(pos);
+            citers[i]->writeItem(i<_nColumns ? getValue(i) : _bmVal);
+        }
+        ++pos[2];
+    }
+
+    /**
+     * Flush the chunks that are still open.
+     */
+    void flush()
+    {
+        for(auto& citers : _citers)
+        {
+            for(auto& citer : citers)
+            {
+                if(citer)
+                {
+                    citer->flush();
+                    citer.reset();
+                }
+            }
+        }
+    }
+
+private:
+    shared_ptr<Query> _query;
+    size_t const      _messageRows;
+    size_t const      _nColumns;
+    vector <vector<shared_ptr<ArrayIterator> > > _oaiters;
+    vector <vector<shared_ptr<ChunkIterator> > > _citers;
+    vector <Coordinates>                         _positions;
+    Value                                        _bmVal;
+};
+
+/**
+ * The rows received from the exchange, numbered by source instance and then by position. The values stay in the
+ * exchanged array; only the number of rows from each source is kept, and rows are read back a column at a time.
+ */
+class ReceivedRows
+{
+public:
+    ReceivedRows(shared_ptr<Array> const& received, size_t nInstances):
+        _received(received),
+        _offsets(nInstances+1, 0)
+    {
+        for (const auto& attr : received->getArrayDesc().getAttributes(true))
+        {
+            _attrs.push_back(attr);
+        }
+        // the rows from each source are dense from 0, so the end of the last chunk of a source is its row count
+        vector<size_t> counts(nInstances, 0);
+        for(shared_ptr<ConstArrayIterator> aiter = received->getConstIterator(_attrs[0]); !aiter->end(); ++(*aiter))
+        {
+            Coordinates const& pos = aiter->getPosition();
+            counts[pos[1]] = std::max(counts[pos[1]], (size_t) pos[2] + aiter->getChunk().count());
+        }
+        for(size_t src = 0; src<nInstances; ++src)
+        {
+            _offsets[src+1] = _offsets[src] + counts[src];
+        }
+    }
+
+    size_t size() const
+    {
+        return _offsets.back();
+    }
+
+    /**
+     * Call f with the number and value of every row of one column, in the order they are stored.
+     */
+    template <typename FUNC>
+    void forEachValue(size_t column, FUNC f)
+    {
+        shared_ptr<ConstArrayIterator> aiter = _received->getConstIterator(_attrs[column]);
+        for(; !aiter->end(); ++(*aiter))
+        {
+            size_t const offset = _offsets[aiter->getPosition()[1]];
+            for(shared_ptr<ConstChunkIterator> citer = aiter->getChunk().getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS); !citer->end(); ++(*citer))
+            {
+                f(offset + citer->getPosition()[2], citer->getItem());
+            }
+        }
+    }
+
+private:
+    shared_ptr<Array>     _received;
+    vector<AttributeDesc> _attrs;
+    vector<size_t>        _offsets;
+};
+
+ArrayDesc Partitioner::makeExchangeSchema(size_t nColumns) const
+{
+    Dimensions dims;
+    dims.push_back(DimensionDesc("dst_instance_id", 0, _nInstances-1,              1,            0));
+    dims.push_back(DimensionDesc("src_instance_id", 0, _nInstances-1,              1,            0));
+    dims.push_back(DimensionDesc("value_no",        0, CoordinateBounds::getMax(), _messageRows, 0));
+    Attributes attrs;
+    for (const auto& attr : _inputSchema.getAttributes(true))
+    {
+        attrs.push_back(AttributeDesc(attr.getName(), attr.getType(), AttributeDesc::IS_NULLABLE, CompressorType::NONE));
+    }
+    if(nColumns > _nAttrs)
+    {
+        attrs.push_back(AttributeDesc("ordered_by_coordinate", TID_INT64, 0, CompressorType::NONE));
+    }
+    attrs.addEmptyTagAttribute();
+    return ArrayDesc(_inputSchema.getName(), attrs, dims, createDistribution(dtByRow), _query->getDefaultArrayResidency());
+}
+
+ArrayDesc Partitioner::makeMessageSchema(size_t rowInterval) const
+{
+    Dimensions dims;
+    dims.push_back(DimensionDesc("message_no", 0, CoordinateBounds::getMax(), 1,           0));
+    dims.push_back(DimensionDesc("row",        0, CoordinateBounds::getMax(), rowInterval, 0));
+    Attributes attrs;
+    for (const auto& attr : _inputSchema.getAttributes(true))
+    {
+        attrs.push_back(AttributeDesc(attr.getName(), attr.getType(), AttributeDesc::IS_NULLABLE, CompressorType::NONE));
+    }
+    attrs.addEmptyTagAttribute();
+    return ArrayDesc(_inputSchema.getName(), attrs, dims, createDistribution(dtUndefined), _query->getDefaultArrayResidency());
+}
+
+template <typename FUNC>
+void Partitioner::forEachCell(shared_ptr<Array>& input, FUNC f)
+{
+    vector <shared_ptr<ConstArrayIterator> > aiters (_nAttrs);
+    vector <shared_ptr<ConstChunkIterator> > citers (_nAttrs);
+    size_t i = 0;
+    for (const auto& attr : _inputSchema.getAttributes(true))
+    {
+        aiters[i++] = input->getConstIterator(attr);
+    }
+    while(!aiters[0]->end())
+    {
+        if(!_sampler || _sampler->keepChunk(aiters[0]->getPosition()))
+        {
+            for(i = 0; i<_nAttrs; ++i)
+            {
+                citers[i] = aiters[i]->getChunk().getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
+            }
+            while(!citers[0]->end())
+            {
+                if(!_sampler || _sampler->keepCell(citers[0]->getPosition()))
+                {
+                    f(citers);
+                }
+                for(i = 0; i<_nAttrs; ++i)
+                {
+                    ++(*citers[i]);
+                }
+            }
+        }
+        for(i = 0; i<_nAttrs; ++i)
+        {
+            ++(*aiters[i]);
+        }
+    }
+}
+
+shared_ptr<Array> Partitioner::hashPartition(shared_ptr<Array>& input, string const& key, shared_ptr<PhysicalOperator> const& op)
+{
+    size_t const keyIdx = findAttribute(key);
+    TypeEnum const keyType = typeId2TypeEnum(_inputSchema.getAttributes(true).findattr(keyIdx).getType(), true);
+    shared_ptr<Array> outgoing(new MemArray(makeExchangeSchema(_nAttrs), _query));
+    ExchangeWriter writer(outgoing, _nInstances, _instanceId, _messageRows, _query);
+    forEachCell(input, [&](vector <shared_ptr<ConstChunkIterator> > const& citers)
+    {
+        string const k = keyBytes(citers[keyIdx]->getItem(), keyType);
+        uint32_t hash;
+        MurmurHash3_x86_32(k.data(), (int) k.size(), 0, &hash);
+        writer.append(hash % _nInstances, [&](size_t i) -> Value const& { return citers[i]->getItem(); });
+    });
+    writer.flush();
+    ReceivedRows rows(exchange(outgoing, op), _nInstances);
+    outgoing.reset();
+    // group the rows by key, reading the key column only
+    size_t const nRows = rows.size();
+    vector<size_t> groupOf(nRows);
+    vector<size_t> groupSize;
+    std::unordered_map<string, size_t> groups;
+    rows.forEachValue(keyIdx, [&](size_t r, Value const& value)
+    {
+        size_t const g = groups.insert(std::make_pair(keyBytes(value, keyType), groups.size())).first->second;
+        if(g == groupSize.size())
+        {
+            groupSize.push_back(0);
+        }
+        ++groupSize[g];
+        groupOf[r] = g;
+    });
+    std::unordered_map<string, size_t>().swap(groups);
+    size_t const nGroups = groupSize.size();
+    LOG4CXX_DEBUG(logger, "stream partition received "<<nRows<<" rows in "<<nGroups<<" groups");
+    // counting sort of the rows by group, groups in the order they were first seen
+    vector<size_t> groupStart(nGroups+1, 0);
+    size_t largestGroup = 0;
+    for(size_t g = 0; g<nGroups; ++g)
+    {
+        groupStart[g+1] = groupStart[g] + groupSize[g];
+        largestGroup = std::max(largestGroup, groupSize[g]);
+    }
+    vector<size_t> rowOrder(nRows);
+    vector<size_t> next(groupStart.begin(), groupStart.end()-1);
+    for(size_t r = 0; r<nRows; ++r)
+    {
+        rowOrder[next[groupOf[r]]++] = r;
+    }
+    vector<size_t>().swap(groupOf);
+    shared_ptr<Array> messages(new MemArray(makeMessageSchema(std::max(_messageRows, largestGroup)), _query));
+    vector<size_t> bounds(1, 0);
+    for(size_t g = 0; g<nGroups; ++g)
+    {
+        if(groupStart[g+1] - bounds.back() > _messageRows && groupStart[g] > bounds.back())
+        {
+            bounds.push_back(groupStart[g]);
+        }
+    }
+    if(bounds.back() < nRows)
+    {
+        bounds.push_back(nRows);
+    }
+    writeMessages(messages, rows, rowOrder, bounds);
+    return messages;
+}
+
+std::pair<Coordinate, Coordinate> Partitioner::getGlobalRange(shared_ptr<Array>& input, size_t dimIdx)
+{
+    Coordinate range[2] = { CoordinateBounds::getMax(), CoordinateBounds::getMin() };
+    shared_ptr<ConstArrayIterator> aiter = input->getConstIterator(_inputSchema.getAttributes(true).firstDataAttribute());
+    while(!aiter->end())
+    {
+        ConstChunk const& chunk = aiter->getChunk();
+        range[0] = std::min(range[0], chunk.getFirstPosition(false)[dimIdx]);
+        range[1] = std::max(range[1], chunk.getLastPosition(false)[dimIdx]);
+        ++(*aiter);
+    }
+    shared_ptr<SharedBuffer> buf(new MemoryBuffer(range, sizeof(range)));
+    for(InstanceID i = 0; i<_nInstances; ++i)
+    {
+        if(i != _instanceId)
+        {
+            BufSend(i, buf, _query);
+        }
+    }
+    for(InstanceID i = 0; i<_nInstances; ++i)
+    {
+        if(i != _instanceId)
+        {
+            Coordinate const* remote = (Coordinate const*) BufReceive(i, _query)->getConstData();
+            range[0] = std::min(range[0], remote[0]);
+            range[1] = std::max(range[1], remote[1]);
+        }
+    }
+    return std::make_pair(range[0], range[1]);
+}
+
+shared_ptr<Array> Partitioner::rangePartition(shared_ptr<Array>& input, string const& dim, shared_ptr<PhysicalOperator> const& op)
+{
+    size_t const dimIdx = findDimension(dim);
+    std::pair<Coordinate, Coordinate> const range = getGlobalRange(input, dimIdx);
+    // the chunk bounds may be wider than the cells in them, so clamp the destinations below
+    long double const width = range.first > range.second ? 1 : ((long double) range.second - range.first + 1) / _nInstances;
+    LOG4CXX_DEBUG(logger, "stream ordered_by "<<dim<<" range "<<range.first<<" to "<<range.second);
+    shared_ptr<Array> outgoing(new MemArray(makeExchangeSchema(_nAttrs+1), _query));
+    ExchangeWriter writer(outgoing, _nInstances, _instanceId, _messageRows, _query);
+    Value coord;
+    forEachCell(input, [&](vector <shared_ptr<ConstChunkIterator> > const& citers)
+    {
+        Coordinate const c = citers[0]->getPosition()[dimIdx];
+        size_t const dst = std::min<size_t>(_nInstances-1, (size_t) (((long double) c - range.first) / width));
+        coord.setInt64(c);
+        writer.append(dst, [&](size_t i) -> Value const& { return i<_nAttrs ? citers[i]->getItem() : coord; });
+    });
+    writer.flush();
+    ReceivedRows rows(exchange(outgoing, op), _nInstances);
+    outgoing.reset();
+    // sort the row numbers by coordinate, reading the coordinate column only
+    size_t const nRows = rows.size();
+    vector<Coordinate> coords(nRows);
+    vector<size_t> rowOrder(nRows);
+    rows.forEachValue(_nAttrs, [&](size_t r, Value const& value)
+    {
+        coords[r] = value.getInt64();
+        rowOrder[r] = r;
+    });
+    std::stable_sort(rowOrder.begin(), rowOrder.end(), [&](size_t a, size_t b) { return coords[a] < coords[b]; });
+    vector<Coordinate>().swap(coords);
+    LOG4CXX_DEBUG(logger, "stream ordered_by received "<<nRows<<" rows");
+    shared_ptr<Array> messages(new MemArray(makeMessageSchema(_messageRows), _query));
+    vector<size_t> bounds;
+    for(size_t first = 0; first<nRows; first += _messageRows)
+    {
+        bounds.push_back(first);
+    }
+    bounds.push_back(nRows);
+    writeMessages(messages, rows, rowOrder, bounds);
+    return messages;
+}
+
+shared_ptr<Array> Partitioner::exchange(shared_ptr<Array>& outgoing, shared_ptr<PhysicalOperator> const& op)
+{
+    return redistributeToRandomAccess(outgoing, createDistribution(dtByRow), _query->getDefaultArrayResidency(), _query, op);
+}
+
+void Partitioner::writeMessages(shared_ptr<Array>& messages, ReceivedRows& rows, vector<size_t> const& rowOrder,
+                                vector<size_t> const& bounds)
+{
+    // read each column once, in the order it is stored, into the slot its rows take in the messages, rather than
+    // looking every row up in the exchanged array in message order
+    size_t const nRows = rowOrder.size();
+    vector<size_t> slotOf(nRows);
+    for(size_t j = 0; j<nRows; ++j)
+    {
+        slotOf[rowOrder[j]] = j;
+    }
+    vector<Value> column(nRows);
+    Value bmVal;
+    bmVal.setBool(true);
+    size_t i = 0;
+    for (const auto& attr : messages->getArrayDesc().getAttributes(false))
+    {
+        if(!attr.isEmptyIndicator())
+        {
+            rows.forEachValue(i, [&](size_t r, Value const& value)
+            {
+                column[slotOf[r]] = value;
+            });
+        }
+        shared_ptr<ArrayIterator> oaiter = messages->getIterator(attr);
+        for(size_t m = 0; m+1<bounds.size(); ++m)
+        {
+            Coordinates pos { (Coordinate) m, 0 };
+            shared_ptr<ChunkIterator> ociter = oaiter->newChunk(pos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE | ChunkIterator::NO_EMPTY_CHECK);
+            Coordinates valPos = pos;
+            for(size_t j = bounds[m]; j<bounds[m+1]; ++j)
+            {
+                ociter->setPosition(valPos);
+                ociter->writeItem(attr.isEmptyIndicator() ? bmVal : column[j]);
+                ++valPos[1];
+            }
+            ociter->flush();
+        }
+        ++i;
+    }
+}
+
+} }
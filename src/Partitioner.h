@@ -0,0 +1,130 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_PARTITIONER_H_
+#define SRC_PARTITIONER_H_
+
+#include <query/PhysicalOperator.h>
+
+namespace scidb { namespace stream
+{
+
+class Sampler;
+class ReceivedRows;
+
+/**
+ * Moves the rows of the input array between instances, either so that all the rows with the same key end up on the
+ * same instance, or so that each instance gets a contiguous range of one dimension. The rows are sent with a single
+ * exchange of an array dimensioned [dst_instance, src_instance, value_no] that is redistributed by dst_instance, so
+ * there is no redimension or sort of the input.
+ *
+ * The rows are written into the exchange array as the input is read, and the messages are read back from the
+ * exchanged array, which SciDB may spill like any other; only the row order, the values of one column at a time
+ * and, for a hash partition, the distinct keys are held in memory.
+ *
+ * The result is a local array dimensioned [message_no, row] with the attributes of the input. Each chunk is one
+ * message, and messages are streamed in message_no order.
+ */
+class Partitioner
+{
+public:
+    /**
+     * The default number of rows per message.
+     */
+    static size_t const MESSAGE_ROWS = 100000;
+
+    /**
+     * @param inputSchema the schema of the array to partition
+     * @param messageRows the preferred number of rows per message
+     * @param sampler if not NULL, only the chunks and cells it keeps are partitioned
+     * @param query the query context
+     */
+    Partitioner(ArrayDesc const& inputSchema, size_t messageRows, Sampler const* sampler, std::shared_ptr<Query> const& query);
+
+    /**
+     * Partition the input by the MurmurHash3 of the value of attribute key, modulo the number of instances, then
+     * group the rows by key. Null keys form one group. Groups are added to a message as long as it stays within
+     * messageRows rows; a larger group gets a message of its own.
+     * @param input the local part of the array to partition
+     * @param key the name of the key attribute
+     * @param op the operator, for the exchange
+     * @return the local messages array
+     */
+    std::shared_ptr<Array> hashPartition(std::shared_ptr<Array>& input, std::string const& key, std::shared_ptr<PhysicalOperator> const& op);
+
+    /**
+     * Partition the input into equal ranges of dimension dim between the global minimum and maximum coordinates
+     * present, instance 0 getting the lowest range, then sort the rows of each instance by that coordinate. Rows
+     * with the same coordinate keep the order in which they were received.
+     * @param input the local part of the array to partition
+     * @param dim the name of the dimension
+     * @param op the operator, for the exchange
+     * @return the local messages array, with messageRows rows per message in ascending order
+     */
+    std::shared_ptr<Array> rangePartition(std::shared_ptr<Array>& input, std::string const& dim, std::shared_ptr<PhysicalOperator> const& op);
+
+private:
+    std::shared_ptr<Query> _query;
+    ArrayDesc              _inputSchema;
+    size_t const           _messageRows;
+    Sampler const*         _sampler;
+    size_t const           _nAttrs;
+    size_t const           _nInstances;
+    InstanceID const       _instanceId;
+
+    size_t findAttribute(std::string const& name) const;
+    size_t findDimension(std::string const& name) const;
+    ArrayDesc makeExchangeSchema(size_t nColumns) const;
+    ArrayDesc makeMessageSchema(size_t rowInterval) const;
+
+    /**
+     * Call f with the cell iterators of all attributes of the input at each cell kept by the sampler; f must not
+     * advance them.
+     */
+    template <typename FUNC>
+    void forEachCell(std::shared_ptr<Array>& input, FUNC f);
+
+    /**
+     * Exchange the local minimum and maximum coordinates of dimension dimIdx with all other instances.
+     * @return the global minimum and maximum; min is greater than max if the array is empty
+     */
+    std::pair<Coordinate, Coordinate> getGlobalRange(std::shared_ptr<Array>& input, size_t dimIdx);
+
+    /**
+     * Redistribute the exchange array, so that this instance holds all the rows sent to it by all instances.
+     */
+    std::shared_ptr<Array> exchange(std::shared_ptr<Array>& outgoing, std::shared_ptr<PhysicalOperator> const& op);
+
+    /**
+     * Write the received rows, in the order given by rowOrder, as message chunks; message m holds the rows
+     * rowOrder[bounds[m], bounds[m+1]).
+     */
+    void writeMessages(std::shared_ptr<Array>& messages, ReceivedRows& rows, std::vector<size_t> const& rowOrder,
+                       std::vector<size_t> const& bounds);
+};
+
+} }
+
+#endif /* SRC_PARTITIONER_H_ */
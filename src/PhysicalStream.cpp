@@ -24,6 +24,7 @@
 */
 
 #include <limits>
+#include <set>
 #include <sstream>
 #include <memory>
 #include <string>
@@ -34,6 +35,7 @@
 #include <sys/wait.h>
 #include <query/TypeSystem.h>
 #include <query/PhysicalOperator.h>
+#include <array/RLE.h>
 #include <log4cxx/logger.h>
 
 #include "StreamSettings.h"
@@ -41,6 +43,11 @@
 #include "TSVInterface.h"
 #include "DFInterface.h"
 #include "FeatherInterface.h"
+#include "SideInputCache.h"
+#include "InputCache.h"
+#include "ResultCache.h"
+#include "Partitioner.h"
+#include "Sampler.h"
 
 using std::shared_ptr;
 using std::make_shared;
@@ -63,69 +70,487 @@ public:
         std::string const& physicalName,
         Parameters const& parameters,
         ArrayDesc const& schema):
-            PhysicalOperator(logicalName, physicalName, parameters, schema)
+            PhysicalOperator(logicalName, physicalName, parameters, schema),
+            _zipParsed(false),
+            _zip(false)
     {}
 
+private:
+    mutable bool _zipParsed;
+    mutable bool _zip;
+
+public:
+
+    /**
+     * Call f at each chunk position of an array, in order, until f returns false. f gets the position and a function
+     * that fetches the chunks of all the attributes there, so it can skip the fetch. Chunk positions that the
+     * sampler, if any, drops are skipped.
+     */
+    template <typename FUNC>
+    static void forEachChunkPosition(shared_ptr<Array> const& array, FUNC f, Sampler const* sampler = NULL)
+    {
+        ArrayDesc const& schema = array->getArrayDesc();
+        size_t const nAttrs = schema.getAttributes(true).size();
+        vector <shared_ptr<ConstArrayIterator> > aiters (nAttrs);
+        vector<ConstChunk const*> chunks(nAttrs, NULL);
+        size_t i = 0;
+        for (const auto& attr : schema.getAttributes(true))
+        {
+            aiters[i++] = array->getConstIterator(attr);
+        }
+        auto fetchChunks = [&]() -> vector<ConstChunk const*> const&
+        {
+            for(size_t j = 0; j<nAttrs; ++j)
+            {
+               chunks[j]= &(aiters[j]->getChunk());
+            }
+            return chunks;
+        };
+        while(!aiters[0]->end())
+        {
+            Coordinates const& pos = aiters[0]->getPosition();
+            if(!sampler || sampler->keepChunk(pos))
+            {
+                if(!f(pos, fetchChunks))
+                {
+                    return;
+                }
+            }
+            for(i = 0; i<nAttrs; ++i)
+            {
+                ++(*aiters[i]);
+            }
+        }
+    }
+
+    /**
+     * Call f on the chunks of all the attributes of an array at each chunk position, in order, until f returns false.
+     * Chunk positions that the sampler, if any, drops are skipped before their chunks are fetched.
+     */
+    template <typename FUNC>
+    static void forEachChunk(shared_ptr<Array> const& array, FUNC f, Sampler const* sampler = NULL)
+    {
+        forEachChunkPosition(array, [&](Coordinates const&, auto const& fetchChunks)
+        {
+            return f(fetchChunks());
+        }, sampler);
+    }
+
+    /**
+     * Send an encoded message to the child and read the response. With a result cache, a cached response to the
+     * same message is replayed instead and the child never sees the message; a new response is stored if it can be
+     * decoded on its own.
+     */
     template <typename INTERFACE>
-    shared_ptr<Array> runStream(vector <shared_ptr<Array> > &inputArrays, Settings const& settings, shared_ptr<Query>& query)
+    static void sendEncoded(vector<char> const& message, INTERFACE& interface, ChildProcess& child, ResultCache* results)
     {
-        ChildProcess child(settings.getCommand(), query);
-        INTERFACE interface(settings, _schema, query);
-        if(inputArrays.size() == 2)
+        if(!results)
         {
-            shared_ptr<Array> preArray = inputArrays[1];
-            ArrayDesc const& preSchema = preArray->getArrayDesc();
-            interface.setInputSchema(preSchema);
-            size_t const nAttrs = preSchema.getAttributes(true).size();
-            vector <shared_ptr<ConstArrayIterator> > aiters (nAttrs);
-            vector<ConstChunk const*> chunks(nAttrs, NULL);
-            //            for(size_t i =0; i<nAttrs; ++i)
-            size_t i = 0;
-            for (const auto& attr : preSchema.getAttributes(true))
+            interface.streamEncoded(message, child);
+            return;
+        }
+        vector<char> response;
+        if(results->read(message, response))
+        {
+            child.replay(response);
+            interface.readResponse(child);
+            return;
+        }
+        child.startRecording(&response);
+        interface.streamEncoded(message, child);
+        child.stopRecording();
+        if(interface.isResponseCacheable())
+        {
+            results->write(message, response);
+        }
+    }
+
+    /**
+     * Stream the chunks at one position to the child, through the result cache if there is one.
+     */
+    template <typename INTERFACE>
+    static void streamChunks(vector<ConstChunk const*> const& chunks, INTERFACE& interface, ChildProcess& child, ResultCache* results)
+    {
+        if(!results)
+        {
+            interface.streamData(chunks, child);
+            return;
+        }
+        MessageRecorder message;
+        if(interface.encodeData(chunks, message))
+        {
+            sendEncoded(message.data(), interface, child, results);
+        }
+    }
+
+    /**
+     * Stream every chunk of an array to the child, one message per chunk position, sampling chunks and cells with
+     * the sampler if there is one. Stops without fetching any more chunks once the child asks to stop.
+     */
+    template <typename INTERFACE>
+    void streamArray(shared_ptr<Array> const& array, INTERFACE& interface, ChildProcess& child, Sampler const* sampler = NULL,
+                     ResultCache* results = NULL)
+    {
+        if(interface.isStopRequested())
+        {
+            return;
+        }
+        interface.setInputSchema(array->getArrayDesc(), sampler);
+        if(results)
+        {
+            results->setInputSchema(interface.getInputSchemaKey());
+        }
+        forEachChunk(array, [&](vector<ConstChunk const*> const& chunks)
+        {
+            streamChunks(chunks, interface, child, results);
+            if(interface.isStopRequested())
             {
-                aiters[i++] = preArray->getConstIterator(attr);
+                LOG4CXX_DEBUG(logger, "stream child asked to stop at chunk "<<CoordsToStr(chunks[0]->getFirstPosition(false)));
+                return false;
             }
-            while(!aiters[0]->end())
+            return true;
+        }, sampler);
+    }
+
+    /**
+     * Like streamArray, but look each chunk position up in the input cache first. A hit sends the cached message
+     * without fetching the chunks; a miss encodes the chunks and stores the message, or an empty file if the chunks
+     * have no cells to send.
+     */
+    template <typename INTERFACE>
+    void streamCachedArray(shared_ptr<Array> const& array, INTERFACE& interface, ChildProcess& child, InputCache& cache,
+                           Sampler const* sampler = NULL, ResultCache* results = NULL)
+    {
+        if(interface.isStopRequested())
+        {
+            return;
+        }
+        interface.setInputSchema(array->getArrayDesc(), sampler);
+        if(results)
+        {
+            results->setInputSchema(interface.getInputSchemaKey());
+        }
+        vector<char> cached;
+        MessageRecorder message;
+        forEachChunkPosition(array, [&](Coordinates const& pos, auto const& fetchChunks)
+        {
+            if(cache.read(pos, cached))
             {
-                for(i =0; i<nAttrs; ++i)
+                if(cached.size())
                 {
-                   chunks[i]= &(aiters[i]->getChunk());
+                    sendEncoded(cached, interface, child, results);
                 }
-                interface.streamData(chunks, child);
-                for(size_t i =0; i<nAttrs; ++i)
+            }
+            else
+            {
+                message.clear();
+                interface.encodeData(fetchChunks(), message);
+                cache.write(pos, message.data());
+                if(message.data().size())
+                {
+                    sendEncoded(message.data(), interface, child, results);
+                }
+            }
+            if(interface.isStopRequested())
+            {
+                LOG4CXX_DEBUG(logger, "stream child asked to stop at chunk "<<CoordsToStr(pos));
+                return false;
+            }
+            return true;
+        }, sampler);
+    }
+
+    /**
+     * Stream every chunk of an array to the child without the result cache, and mix the messages into the keys of
+     * the cache. Used for the side input, which the child must always see.
+     */
+    template <typename INTERFACE>
+    void streamContext(shared_ptr<Array> const& array, INTERFACE& interface, ChildProcess& child, ResultCache& results)
+    {
+        interface.setInputSchema(array->getArrayDesc());
+        MessageRecorder message;
+        forEachChunk(array, [&](vector<ConstChunk const*> const& chunks)
+        {
+            message.clear();
+            if(interface.encodeData(chunks, message))
+            {
+                results.addContext(message.data().data(), message.data().size());
+                interface.streamEncoded(message.data(), child);
+            }
+            return !interface.isStopRequested();
+        });
+    }
+
+    /**
+     * Encode the messages for every chunk of an array into the cache, without a child.
+     */
+    template <typename INTERFACE>
+    void cacheArray(shared_ptr<Array> const& array, INTERFACE& interface, SideInputCache& cache)
+    {
+        interface.setInputSchema(array->getArrayDesc());
+        MessageRecorder message;
+        forEachChunk(array, [&](vector<ConstChunk const*> const& chunks)
+        {
+            message.clear();
+            if(interface.encodeData(chunks, message))
+            {
+                cache.append(message.data());
+            }
+            return true;
+        });
+        cache.commit();
+    }
+
+    /**
+     * The schema of a zipped message: the attributes of all inputs side by side, in input order. Attribute names
+     * that are already taken by an earlier input get the input number appended.
+     */
+    static ArrayDesc makeZipSchema(vector <shared_ptr<Array> > const& inputArrays)
+    {
+        Attributes zipAttrs;
+        std::set<string> names;
+        for(size_t k = 0; k<inputArrays.size(); ++k)
+        {
+            for (const auto& attr : inputArrays[k]->getArrayDesc().getAttributes(true))
+            {
+                string name = attr.getName();
+                if(names.count(name))
                 {
-                    ++(*aiters[i]);
+                    ostringstream uniqueName;
+                    uniqueName<<name<<"_"<<k;
+                    name = uniqueName.str();
                 }
+                names.insert(name);
+                zipAttrs.push_back(AttributeDesc(name, attr.getType(), attr.getFlags(), attr.getDefaultCompressionMethod()));
             }
         }
-        shared_ptr<Array> inputArray = inputArrays[0];
-        ArrayDesc const& inputSchema = inputArray ->getArrayDesc();
-        interface.setInputSchema(inputSchema);
-        size_t const nAttrs = inputSchema.getAttributes(true).size();
-        vector <shared_ptr<ConstArrayIterator> > aiters (nAttrs);
-        vector<ConstChunk const*> chunks(nAttrs, NULL);
-        //        for(size_t i =0; i<nAttrs; ++i)
-        size_t i = 0;
-        for (const auto& attr : inputSchema.getAttributes(true))
+        ArrayDesc const& leadSchema = inputArrays[0]->getArrayDesc();
+        return ArrayDesc(leadSchema.getName(), zipAttrs, leadSchema.getDimensions(), leadSchema.getDistribution(), leadSchema.getResidency());
+    }
 
+    /**
+     * @return true if the two chunks have the same cells, so their attribute values can be sent side by side
+     */
+    static bool sameCells(ConstChunk const& a, ConstChunk const& b)
+    {
+        if(a.count() != b.count())
         {
-            aiters[i++] = inputArray->getConstIterator(attr);
+            return false;
         }
+        shared_ptr<ConstRLEEmptyBitmap> aBitmap = a.getEmptyBitmap();
+        shared_ptr<ConstRLEEmptyBitmap> bBitmap = b.getEmptyBitmap();
+        if(!aBitmap || !bBitmap)
+        {
+            // without both bitmaps, such as for the chunks of some virtual arrays, compare the positions of the cells
+            shared_ptr<ConstChunkIterator> aIter = a.getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
+            shared_ptr<ConstChunkIterator> bIter = b.getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
+            for(; !aIter->end() && !bIter->end(); ++(*aIter), ++(*bIter))
+            {
+                if(aIter->getPosition() != bIter->getPosition())
+                {
+                    return false;
+                }
+            }
+            return aIter->end() && bIter->end();
+        }
+        if(aBitmap->nSegments() != bBitmap->nSegments())
+        {
+            return false;
+        }
+        for(size_t i = 0, n = aBitmap->nSegments(); i<n; ++i)
+        {
+            ConstRLEEmptyBitmap::Segment const& aSeg = aBitmap->getSegment(i);
+            ConstRLEEmptyBitmap::Segment const& bSeg = bBitmap->getSegment(i);
+            if(aSeg._lPosition != bSeg._lPosition || aSeg._length != bSeg._length)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Walk the chunks of all the co-located inputs in lockstep and send every aligned group of chunks as one message
+     * that carries the attributes of all inputs. The first input drives the walk; chunk positions that are missing
+     * from any of the other inputs are skipped, like cells missing from one side of a join. The sampler picks chunk
+     * positions and cells for all inputs at once.
+     */
+    template <typename INTERFACE>
+    void streamZipped(vector <shared_ptr<Array> > const& inputArrays, INTERFACE& interface, ChildProcess& child, Sampler const* sampler,
+                      ResultCache* results)
+    {
+        interface.setInputSchema(makeZipSchema(inputArrays), sampler);
+        if(results)
+        {
+            results->setInputSchema(interface.getInputSchemaKey());
+        }
+        size_t const nInputs = inputArrays.size();
+        vector <shared_ptr<ConstArrayIterator> > aiters;
+        vector <size_t> firstAttr(nInputs);
+        for(size_t k = 0; k<nInputs; ++k)
+        {
+            firstAttr[k] = aiters.size();
+            for (const auto& attr : inputArrays[k]->getArrayDesc().getAttributes(true))
+            {
+                aiters.push_back(inputArrays[k]->getConstIterator(attr));
+            }
+        }
+        size_t const nAttrs = aiters.size();
+        size_t const nLeadAttrs = firstAttr[1];
+        vector<ConstChunk const*> chunks(nAttrs, NULL);
         while(!aiters[0]->end())
         {
-            for(i = 0; i<nAttrs; ++i)
+            Coordinates const pos = aiters[0]->getPosition();
+            bool aligned = sampler->keepChunk(pos);
+            for(size_t i = nLeadAttrs; i<nAttrs && aligned; ++i)
             {
-               chunks[i]= &(aiters[i]->getChunk());
+                aligned = aiters[i]->setPosition(pos);
             }
-            interface.streamData(chunks, child);
-            for(size_t i =0; i<nAttrs; ++i)
+            if(aligned)
+            {
+                for(size_t i = 0; i<nAttrs; ++i)
+                {
+                    chunks[i] = &(aiters[i]->getChunk());
+                }
+                for(size_t k = 1; k<nInputs; ++k)
+                {
+                    if(!sameCells(*chunks[0], *chunks[firstAttr[k]]))
+                    {
+                        ostringstream error;
+                        error<<"zip input "<<k<<" does not have the same cells as the first input in chunk "<<CoordsToStr(pos);
+                        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+                    }
+                }
+                streamChunks(chunks, interface, child, results);
+                if(interface.isStopRequested())
+                {
+                    LOG4CXX_DEBUG(logger, "stream child asked to stop at chunk "<<CoordsToStr(pos));
+                    return;
+                }
+            }
+            else if(sampler->keepChunk(pos))
+            {
+                LOG4CXX_DEBUG(logger, "stream zip skipping chunk "<<CoordsToStr(pos)<<" missing from other inputs");
+            }
+            for(size_t i = 0; i<nLeadAttrs; ++i)
             {
                 ++(*aiters[i]);
             }
         }
+    }
+
+    template <typename INTERFACE>
+    shared_ptr<Array> runStream(vector <shared_ptr<Array> > &inputArrays, Settings const& settings, shared_ptr<Query>& query)
+    {
+        BufferArena arena;
+        INTERFACE interface(settings, _schema, query, arena);
+        bool streamSide = inputArrays.size() == 2 && !settings.isZip();
+        vector<string> environment;
+        if(!settings.getCompression().empty())
+        {
+            environment.push_back(string(FeatherInterface::COMPRESSION_ENV_VAR) + "=" + settings.getCompression());
+        }
+        if(streamSide && settings.isSideCacheEnabled())
+        {
+            ArrayDesc const& sideSchema = inputArrays[1]->getArrayDesc();
+            // each instance shares the file with the other instances on its host, so it must hold all of ARRAY2
+            bool const replicated = sideSchema.getDistribution()->getDistType() == dtReplication;
+            if(replicated && SideInputCache::isCacheable(sideSchema))
+            {
+                SideInputCache cache(sideSchema, settings);
+                if(!cache.exists())
+                {
+                    cacheArray(inputArrays[1], interface, cache);
+                }
+                else
+                {
+                    LOG4CXX_DEBUG(logger, "stream side input cache hit "<<cache.getPath());
+                }
+                environment.push_back(string(SideInputCache::ENV_VAR) + "=" + cache.getPath());
+                streamSide = false;
+            }
+            else
+            {
+                LOG4CXX_DEBUG(logger, "stream side input is not a stored replicated array version; streaming it instead");
+            }
+        }
+        Sampler const sampler(settings.getSample(), settings.getSampleChunks(), settings.getSeed());
+        Sampler const* inputSampler = settings.isSampled() ? &sampler : NULL;
+        shared_ptr<Array> input = inputArrays[0];
+        if(!settings.getPartitionBy().empty())
+        {
+            Partitioner partitioner(input->getArrayDesc(), Partitioner::MESSAGE_ROWS, inputSampler, query);
+            input = partitioner.hashPartition(input, settings.getPartitionBy(), shared_from_this());
+            inputSampler = NULL;  // sampled before the exchange
+        }
+        else if(!settings.getOrderedBy().empty())
+        {
+            Partitioner partitioner(input->getArrayDesc(), Partitioner::MESSAGE_ROWS, inputSampler, query);
+            input = partitioner.rangePartition(input, settings.getOrderedBy(), shared_from_this());
+            inputSampler = NULL;
+        }
+        shared_ptr<ResultCache> results;
+        if(settings.isResultCacheEnabled())
+        {
+            results = make_shared<ResultCache>(settings.getCommand(), settings.getResultCacheSize());
+            for(string const& var : environment)
+            {
+                results->addContext(var.data(), var.size());
+            }
+        }
+        ChildProcess child(settings.getCommand(), query, environment);
+        if(settings.isZip())
+        {
+            streamZipped(inputArrays, interface, child, &sampler, results.get());
+        }
+        else
+        {
+            if(streamSide && results)
+            {
+                streamContext(inputArrays[1], interface, child, *results);
+            }
+            else if(streamSide)
+            {
+                streamArray(inputArrays[1], interface, child);
+            }
+            ArrayDesc const& inputSchema = input->getArrayDesc();
+            if(settings.isInputCacheEnabled() && input == inputArrays[0] && SideInputCache::isCacheable(inputSchema))
+            {
+                InputCache cache(inputSchema, settings);
+                streamCachedArray(input, interface, child, cache, inputSampler, results.get());
+                LOG4CXX_DEBUG(logger, "stream input cache hits "<<cache.getHits()<<" misses "<<cache.getMisses());
+                cache.trim();
+            }
+            else
+            {
+                streamArray(input, interface, child, inputSampler, results.get());
+            }
+        }
+        if(results)
+        {
+            size_t const nMessages = results->getHits() + results->getMisses();
+            LOG4CXX_INFO(logger, "stream result cache answered "<<results->getHits()<<" of "<<nMessages<<" messages"
+                         <<" (hit ratio "<<(nMessages ? (double) results->getHits() / nMessages : 0)<<")");
+            results->trim();
+        }
         return interface.finalize(child);
     }
 
+    /**
+     * @return true in zip mode; the settings are parsed on the first call only, as the distribution callbacks ask
+     * many times
+     */
+    bool isZip() const
+    {
+        if(!_zipParsed)
+        {
+            Settings settings(_parameters, _kwParameters, false, shared_ptr<Query>());
+            _zip = settings.isZip();
+            _zipParsed = true;
+        }
+        return _zip;
+    }
+
     /// @see OperatorDist
     DistType inferSynthesizedDistType(std::vector<DistType> const& /*inDist*/, size_t /*depth*/) const override
     {
@@ -137,6 +562,10 @@ public:
     // required to allow replicated input
     std::vector<uint8_t> isReplicatedInputOk(size_t numChildren) const override
     {
+        if(isZip())
+        {
+            return vector<uint8_t>(numChildren, false); // zipped inputs must be co-located, not replicated
+        }
         vector<uint8_t> result(numChildren, true);
         SCIDB_ASSERT(numChildren==2);
         result[0] = false;   // permitted on the right-hand input
@@ -145,12 +574,37 @@ public:
 
     void checkInputDistAgreement(std::vector<DistType> const& inDist, size_t /*depth*/) const override
     {
+        if(isZip())
+        {
+            // all inputs are redistributed like input[0], see getDistributionRequirement
+            return;
+        }
         SCIDB_ASSERT(inDist.size() == 2);
         // input[0] can have arbitrary distribution
         // input[1] can be arbitraary
         // NOTE: if the answer is more restrictive than this, then please add SCIDB_ASSERT() about what inDist[0] and inDist[1] can be;
     }
 
+    DistributionRequirement getDistributionRequirement(std::vector<ArrayDesc> const& inputSchemas) const override
+    {
+        if(!isZip())
+        {
+            return PhysicalOperator::getDistributionRequirement(inputSchemas);
+        }
+        // zip walks the chunks of all inputs in lockstep, so every input must be placed like input[0]
+        ArrayDistPtr dist = inputSchemas[0].getDistribution();
+        if(dist->getDistType() == dtUndefined)
+        {
+            dist = createDistribution(dtHashPartitioned);
+        }
+        vector<RedistributeContext> requiredDistribution;
+        for(size_t i = 0; i<inputSchemas.size(); ++i)
+        {
+            requiredDistribution.push_back(RedistributeContext(dist, inputSchemas[0].getResidency()));
+        }
+        return DistributionRequirement(DistributionRequirement::SpecificAnyOrder, requiredDistribution);
+    }
+
     virtual RedistributeContext getOutputDistribution(
                std::vector<RedistributeContext> const& inputDistributions,
                std::vector< ArrayDesc> const& inputSchemas) const
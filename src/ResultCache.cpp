@@ -0,0 +1,116 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "ResultCache.h"
+#include <algorithm>
+#include <limits.h>
+#include "InputCache.h"
+#include "../extern/MurmurHash/MurmurHash3.h"
+
+namespace scidb { namespace stream {
+
+char const* const ResultCache::CACHE_DIR = "/dev/shm/scidb_stream/result";
+
+ResultCache::ResultCache(string const& command, size_t maxBytes):
+    _maxBytes(maxBytes),
+    _bytesWritten(0),
+    _full(false),
+    _hits(0),
+    _misses(0)
+{
+    hash(command.data(), command.size(), _context);
+    hash(NULL, 0, _schema);
+}
+
+void ResultCache::hash(char const* data, size_t size, uint64_t out[2])
+{
+    size_t block = std::min<size_t>(size, INT_MAX);
+    MurmurHash3_x64_128(data, (int) block, 0, out);
+    for(size_t done = block; done < size; done += block)
+    {
+        block = std::min<size_t>(size - done, INT_MAX);
+        uint64_t chain[4] = { out[0], out[1], 0, 0 };
+        MurmurHash3_x64_128(data + done, (int) block, 0, chain + 2);
+        MurmurHash3_x64_128(chain, sizeof(chain), 0, out);
+    }
+}
+
+void ResultCache::addContext(char const* data, size_t size)
+{
+    uint64_t key[4] = { _context[0], _context[1], 0, 0 };
+    hash(data, size, key + 2);
+    MurmurHash3_x64_128(key, sizeof(key), 0, _context);
+}
+
+void ResultCache::setInputSchema(string const& schema)
+{
+    hash(schema.data(), schema.size(), _schema);
+}
+
+string ResultCache::getPath(vector<char> const& message) const
+{
+    uint64_t key[6] = { _context[0], _context[1], _schema[0], _schema[1], 0, 0 };
+    hash(message.data(), message.size(), key + 4);
+    uint64_t path[2];
+    MurmurHash3_x64_128(key, sizeof(key), 0, path);
+    char hex[33];
+    snprintf(hex, sizeof(hex), "%016lx%016lx", (unsigned long) path[0], (unsigned long) path[1]);
+    return string(CACHE_DIR) + "/" + hex;
+}
+
+bool ResultCache::read(vector<char> const& message, vector<char>& response)
+{
+    if(!InputCache::readFile(getPath(message), response))
+    {
+        ++_misses;
+        return false;
+    }
+    ++_hits;
+    return true;
+}
+
+void ResultCache::write(vector<char> const& message, vector<char> const& response)
+{
+    if(_full)
+    {
+        return;
+    }
+    if(_bytesWritten + response.size() > _maxBytes)
+    {
+        LOG4CXX_DEBUG(logger, "stream result cache wrote its limit of "<<_maxBytes<<" bytes, caching no more responses");
+        _full = true;
+        trim();
+        return;
+    }
+    _bytesWritten += response.size();
+    InputCache::writeFile(getPath(message), response);
+}
+
+void ResultCache::trim()
+{
+    InputCache::trimDirectory(CACHE_DIR, _maxBytes);
+}
+
+}}
@@ -0,0 +1,112 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_RESULTCACHE_H_
+#define SRC_RESULTCACHE_H_
+
+#include <query/PhysicalOperator.h>
+
+namespace scidb { namespace stream
+{
+
+/**
+ * A host-wide cache of the responses of the child, for children that are pure functions of their input messages.
+ * A response is keyed by a MurmurHash3 of the command, of any context the child has seen before its data such as
+ * the side input, of the schema of the input messages and of the encoded message it answers. Files are stored with
+ * InputCache::writeFile and trimmed to a size limit with InputCache::trimDirectory; like the input cache, a query
+ * stops storing responses and trims once it has written as many bytes as the limit.
+ */
+class ResultCache
+{
+public:
+    static char const* const CACHE_DIR;
+
+    /**
+     * @param command the command of the child
+     * @param maxBytes the size limit of the cache
+     */
+    ResultCache(std::string const& command, size_t maxBytes);
+
+    /**
+     * Mix data that the child saw but that is not answered from the cache, such as the side input, into all the
+     * keys that follow.
+     */
+    void addContext(char const* data, size_t size);
+
+    /**
+     * Mix the schema of the messages that follow into their keys, in place of any earlier schema.
+     * @param schema the bytes that describe the messages besides the messages themselves, such as the serialized
+     *               Arrow schema that goes only with the first Feather message
+     */
+    void setInputSchema(std::string const& schema);
+
+    /**
+     * Look up the response of the child to a message.
+     * @return true if the response was cached
+     */
+    bool read(std::vector<char> const& message, std::vector<char>& response);
+
+    /**
+     * Store the response of the child to a message, unless this cache has already written its size limit in
+     * responses.
+     */
+    void write(std::vector<char> const& message, std::vector<char> const& response);
+
+    /**
+     * Remove the least recently used responses until the cache is no larger than its limit.
+     */
+    void trim();
+
+    size_t getHits() const
+    {
+        return _hits;
+    }
+
+    size_t getMisses() const
+    {
+        return _misses;
+    }
+
+private:
+    uint64_t _context[2];
+    uint64_t _schema[2];
+    size_t   _maxBytes;
+    size_t   _bytesWritten;
+    bool     _full;
+    size_t   _hits;
+    size_t   _misses;
+
+    std::string getPath(std::vector<char> const& message) const;
+
+    /**
+     * MurmurHash3_x64_128 of any number of bytes; its length argument is an int, so larger data is hashed in blocks
+     * of at most INT_MAX bytes, each chained to the hash of the blocks before it.
+     */
+    static void hash(char const* data, size_t size, uint64_t out[2]);
+};
+
+}}
+
+#endif /* SRC_RESULTCACHE_H_ */
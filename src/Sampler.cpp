@@ -0,0 +1,78 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "Sampler.h"
+#include <cmath>
+#include "../extern/MurmurHash/MurmurHash3.h"
+
+namespace scidb { namespace stream {
+
+/**
+ * @return the probability scaled to a threshold on a uniform 64-bit hash
+ */
+static uint64_t toThreshold(double probability)
+{
+    return probability >= 1 ? std::numeric_limits<uint64_t>::max() : (uint64_t) std::ldexp((long double) probability, 64);
+}
+
+Sampler::Sampler(double cellProbability, double chunkProbability, uint64_t seed):
+    _sampleCells(cellProbability < 1),
+    _sampleChunks(chunkProbability < 1),
+    _cellThreshold(toThreshold(cellProbability)),
+    _chunkThreshold(toThreshold(chunkProbability)),
+    _seed(fmix(seed)),
+    _chunkSeed(fmix(~seed))
+{}
+
+uint64_t Sampler::hash(Coordinates const& pos, uint64_t seed)
+{
+    uint64_t h = seed;
+    for(size_t i = 0; i<pos.size(); ++i)
+    {
+        h = fmix(h ^ fmix((uint64_t) pos[i]));
+    }
+    return h;
+}
+
+size_t Sampler::maskChunk(ConstChunk const& chunk, std::vector<char>& mask) const
+{
+    mask.clear();
+    if(!_sampleCells)
+    {
+        return chunk.count();
+    }
+    size_t nKept = 0;
+    std::shared_ptr<ConstChunkIterator> citer = chunk.getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
+    while(!citer->end())
+    {
+        bool const keep = keepCell(citer->getPosition());
+        mask.push_back(keep);
+        nKept += keep;
+        ++(*citer);
+    }
+    return nKept;
+}
+
+} }
@@ -0,0 +1,94 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_SAMPLER_H_
+#define SRC_SAMPLER_H_
+
+#include <query/PhysicalOperator.h>
+
+namespace scidb { namespace stream
+{
+
+/**
+ * Bernoulli sampling of chunks and cells, pushed into the chunk loops so that skipped chunks are never fetched.
+ * Whether a chunk or a cell is kept depends only on the seed and its coordinates, hashed with the MurmurHash3
+ * finalizer, so all attributes of a cell agree and the same query with the same seed gives the same sample.
+ */
+class Sampler
+{
+public:
+    /**
+     * @param cellProbability the probability to keep a cell, in (0, 1]
+     * @param chunkProbability the probability to keep a chunk, in (0, 1]
+     * @param seed the seed of the sample
+     */
+    Sampler(double cellProbability, double chunkProbability, uint64_t seed);
+
+    /**
+     * @return true if the chunk at chunkPos should be fetched
+     */
+    bool keepChunk(Coordinates const& chunkPos) const
+    {
+        return !_sampleChunks || hash(chunkPos, _chunkSeed) < _chunkThreshold;
+    }
+
+    /**
+     * @return true if the cell at pos should be streamed
+     */
+    bool keepCell(Coordinates const& pos) const
+    {
+        return !_sampleCells || hash(pos, _seed) < _cellThreshold;
+    }
+
+    /**
+     * Decide which cells of a chunk to keep.
+     * @param chunk a chunk of any attribute
+     * @param[out] mask one entry per cell of the chunk, nonzero to keep it; left empty when all cells are kept
+     * @return the number of cells kept
+     */
+    size_t maskChunk(ConstChunk const& chunk, std::vector<char>& mask) const;
+
+    /**
+     * @return true if the cell numbered cell in the chunk order is kept by a mask from maskChunk
+     */
+    static bool keeps(std::vector<char> const& mask, size_t cell)
+    {
+        return mask.empty() || mask[cell];
+    }
+
+private:
+    bool     _sampleCells;
+    bool     _sampleChunks;
+    uint64_t _cellThreshold;
+    uint64_t _chunkThreshold;
+    uint64_t _seed;
+    uint64_t _chunkSeed;
+
+    static uint64_t hash(Coordinates const& pos, uint64_t seed);
+};
+
+} }
+
+#endif /* SRC_SAMPLER_H_ */
@@ -0,0 +1,206 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "SideInputCache.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+namespace scidb { namespace stream {
+
+char const* const SideInputCache::ENV_VAR   = "SCIDB_STREAM_SIDE_INPUT";
+char const* const SideInputCache::CACHE_DIR = "/dev/shm/scidb_stream";
+
+bool SideInputCache::isCacheable(ArrayDesc const& sideSchema)
+{
+    return sideSchema.getUAId() != 0 && sideSchema.getVersionId() != 0;
+}
+
+SideInputCache::SideInputCache(ArrayDesc const& sideSchema, Settings const& settings):
+    _dir(CACHE_DIR),
+    _version(sideSchema.getVersionId()),
+    _tmpFd(-1)
+{
+    string name = sideSchema.getName();
+    size_t const at = name.find('@');
+    if(at != string::npos)
+    {
+        name.resize(at);
+    }
+    for(size_t i = 0; i<name.size(); ++i)
+    {
+        if(!isalnum(name[i]))
+        {
+            name[i] = '_';
+        }
+    }
+    ostringstream prefix;
+    prefix<<"side_"<<name<<"_"<<sideSchema.getUAId()<<"_";
+    _prefix = prefix.str();
+    // the version is followed by the settings that change the bytes of the messages
+    TransferFormat const format = settings.getFormat();
+    ostringstream path;
+    path<<_dir<<"/"<<_prefix<<_version<<(format == TSV ? ".tsv" : format == DF ? ".df" : ".feather");
+    if(format == DF && settings.isInt64AsInteger64())
+    {
+        path<<".integer64";
+    }
+    if(format == FEATHER && !settings.getCompression().empty())
+    {
+        path<<"."<<settings.getCompression();
+    }
+    if(format != TSV && settings.getDictionaryEncoding() != DICTIONARY_NEVER)
+    {
+        path<<(settings.getDictionaryEncoding() == DICTIONARY_AUTO ? ".dictionary_auto" : ".dictionary_always");
+    }
+    _path = path.str();
+}
+
+SideInputCache::~SideInputCache()
+{
+    if(_tmpFd >= 0)
+    {
+        close(_tmpFd);
+        unlink(_tmpPath.c_str());
+    }
+}
+
+bool SideInputCache::exists()
+{
+    if(access(_path.c_str(), R_OK) != 0)
+    {
+        return false;
+    }
+    utimes(_path.c_str(), NULL); // mark as in use
+    removeOlderVersions();
+    return true;
+}
+
+void SideInputCache::openTmp()
+{
+    if(mkdir(_dir.c_str(), 0700) != 0 && errno != EEXIST)
+    {
+        ostringstream error;
+        error<<"could not create side input cache directory "<<_dir<<" errno "<<errno;
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+    }
+    vector<char> tmpl(_path.begin(), _path.end());
+    string const suffix(".XXXXXX");
+    tmpl.insert(tmpl.end(), suffix.begin(), suffix.end());
+    tmpl.push_back(0);
+    _tmpFd = mkstemp(&tmpl[0]);
+    if(_tmpFd < 0)
+    {
+        ostringstream error;
+        error<<"could not create side input cache file in "<<_dir<<" errno "<<errno;
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+    }
+    _tmpPath = &tmpl[0];
+}
+
+void SideInputCache::append(vector<char> const& message)
+{
+    if(_tmpFd < 0)
+    {
+        openTmp();
+    }
+    size_t bytesWritten = 0;
+    while(bytesWritten < message.size())
+    {
+        ssize_t ret = write(_tmpFd, &message[bytesWritten], message.size() - bytesWritten);
+        if(ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(ret <= 0)
+        {
+            ostringstream error;
+            error<<"could not write side input cache file "<<_tmpPath<<" errno "<<errno;
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+        }
+        bytesWritten += ret;
+    }
+}
+
+void SideInputCache::commit()
+{
+    if(_tmpFd < 0)
+    {
+        openTmp(); //the side input had no data; publish an empty file
+    }
+    fchmod(_tmpFd, 0400);
+    close(_tmpFd);
+    _tmpFd = -1;
+    if(rename(_tmpPath.c_str(), _path.c_str()) != 0)
+    {
+        unlink(_tmpPath.c_str());
+        ostringstream error;
+        error<<"could not publish side input cache file "<<_path<<" errno "<<errno;
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+    }
+    LOG4CXX_DEBUG(logger, "stream published side input cache "<<_path);
+    removeOlderVersions();
+}
+
+void SideInputCache::removeOlderVersions()
+{
+    DIR* dir = opendir(_dir.c_str());
+    if(dir == NULL)
+    {
+        return;
+    }
+    time_t const now = time(NULL);
+    while(struct dirent* entry = readdir(dir))
+    {
+        string const entryName(entry->d_name);
+        if(entryName.compare(0, _prefix.size(), _prefix) != 0)
+        {
+            continue;
+        }
+        char* end = NULL;
+        VersionID const version = strtoull(entryName.c_str() + _prefix.size(), &end, 10);
+        if(*end != '.' || version == _version)
+        {
+            continue;
+        }
+        // a query may have just given the path of the file to its child, which has yet to open it
+        string const entryPath = _dir + "/" + entryName;
+        struct stat st;
+        if(stat(entryPath.c_str(), &st) == 0 && st.st_mtime + GRACE_SECONDS < now)
+        {
+            LOG4CXX_DEBUG(logger, "stream removing stale side input cache "<<entryPath);
+            unlink(entryPath.c_str());
+        }
+    }
+    closedir(dir);
+}
+
+}}
@@ -0,0 +1,108 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_SIDEINPUTCACHE_H_
+#define SRC_SIDEINPUTCACHE_H_
+
+#include <query/PhysicalOperator.h>
+#include "StreamSettings.h"
+
+namespace scidb { namespace stream
+{
+
+/**
+ * A host-wide cache of the encoded side input (the optional second array, often a serialized model). The messages
+ * that would be streamed to the child for the side input are stored back to back, exactly as they would appear on
+ * the pipe, in a file in shared memory. The file is keyed by the array name, its unversioned id and version, and
+ * the settings that change the encoded bytes, starting with the transfer format, so all the instances on one host and
+ * all subsequent queries over the same array version and settings share one copy. Instead of streaming the side
+ * input, the child is given the path of the file in the environment variable named by ENV_VAR; it can map the file
+ * and reads the messages from it without responding to them.
+ *
+ * Files are published atomically with a rename, so concurrent writers are harmless. Publishing or using a file
+ * removes the files of the other versions of the array that no query has used for GRACE_SECONDS, so that a child
+ * that was just given the path of such a file can still open it.
+ */
+class SideInputCache
+{
+public:
+    static char const* const ENV_VAR;
+    static char const* const CACHE_DIR;
+    static time_t const GRACE_SECONDS = 600;
+
+    /**
+     * @param sideSchema the schema of the side input array
+     * @return true if the array is a stored array with a version and can be cached
+     */
+    static bool isCacheable(ArrayDesc const& sideSchema);
+
+    /**
+     * @param sideSchema the schema of the side input array, must be cacheable
+     * @param settings the settings of the operator, which determine the encoding of the messages
+     */
+    SideInputCache(ArrayDesc const& sideSchema, Settings const& settings);
+
+    ~SideInputCache();
+
+    /**
+     * @return the path of the cache file
+     */
+    std::string const& getPath() const
+    {
+        return _path;
+    }
+
+    /**
+     * @return true if the cache file is already published, in which case it is marked as in use and the unused
+     * files of other versions are removed
+     */
+    bool exists();
+
+    /**
+     * Append an encoded message to the cache file under construction.
+     * @param message the bytes of the message
+     */
+    void append(std::vector<char> const& message);
+
+    /**
+     * Publish the cache file under construction and remove the unused files of other versions of the same array.
+     */
+    void commit();
+
+private:
+    std::string _dir;
+    std::string _prefix;
+    VersionID   _version;
+    std::string _path;
+    std::string _tmpPath;
+    int         _tmpFd;
+
+    void openTmp();
+    void removeOlderVersions();
+};
+
+}}
+
+#endif /* SRC_SIDEINPUTCACHE_H_ */
@@ -56,6 +56,20 @@ static const char* const KW_FORMAT = "format";
 static const char* const KW_CHUNK_SIZE = "chunk_size";
 static const char* const KW_TYPES = "types";
 static const char* const KW_NAMES = "names";
+static const char* const KW_ZIP = "zip";
+static const char* const KW_SIDE_CACHE = "side_cache";
+static const char* const KW_PARTITION_BY = "partition_by";
+static const char* const KW_ORDERED_BY = "ordered_by";
+static const char* const KW_SAMPLE = "sample";
+static const char* const KW_SAMPLE_CHUNKS = "sample_chunks";
+static const char* const KW_SEED = "seed";
+static const char* const KW_INPUT_CACHE = "input_cache";
+static const char* const KW_INPUT_CACHE_MB = "input_cache_mb";
+static const char* const KW_CACHE = "cache";
+static const char* const KW_CACHE_MB = "cache_mb";
+static const char* const KW_INT64_AS = "int64_as";
+static const char* const KW_COMPRESSION = "compression";
+static const char* const KW_DICTIONARY = "dictionary";
 
 typedef std::shared_ptr<OperatorParamLogicalExpression> ParamType_t ;
 
@@ -66,6 +80,13 @@ typedef std::shared_ptr<OperatorParamLogicalExpression> ParamType_t ;
     FEATHER  // Apache Arrow Feather format
 };
 
+enum DictionaryEncoding
+{
+    DICTIONARY_NEVER,   // string attributes are sent as plain strings
+    DICTIONARY_AUTO,    // chosen for every chunk by probing the cardinality of its strings
+    DICTIONARY_ALWAYS   // string attributes are sent as dictionaries or factors
+};
+
 class Settings
 {
 private:
@@ -75,6 +96,20 @@ private:
     ssize_t             _outputChunkSize;
     bool				_chunkSizeSet;
     string              _command;
+    bool                _zip;
+    bool                _sideCache;
+    string              _partitionBy;
+    string              _orderedBy;
+    double              _sample;
+    double              _sampleChunks;
+    int64_t             _seed;
+    bool                _inputCache;
+    size_t              _inputCacheMb;
+    bool                _cache;
+    size_t              _cacheMb;
+    bool                _int64AsInteger64;
+    string              _compression;
+    DictionaryEncoding  _dictionary;
 
 public:
     static const size_t MAX_PARAMETERS = 1;
@@ -102,10 +137,54 @@ private:
             {
                 _types.push_back(TE_INT64);
             }
+            else if(t == "int8")
+            {
+                _types.push_back(TE_INT8);
+            }
+            else if(t == "int16")
+            {
+                _types.push_back(TE_INT16);
+            }
+            else if(t == "uint8")
+            {
+                _types.push_back(TE_UINT8);
+            }
+            else if(t == "uint16")
+            {
+                _types.push_back(TE_UINT16);
+            }
+            else if(t == "uint32")
+            {
+                _types.push_back(TE_UINT32);
+            }
+            else if(t == "uint64")
+            {
+                _types.push_back(TE_UINT64);
+            }
             else if(t == "double")
             {
                 _types.push_back(TE_DOUBLE);
             }
+            else if(t == "float")
+            {
+                _types.push_back(TE_FLOAT);
+            }
+            else if(t == "bool")
+            {
+                _types.push_back(TE_BOOL);
+            }
+            else if(t == "datetime")
+            {
+                _types.push_back(TE_DATETIME);
+            }
+            else if(t == "datetimetz")
+            {
+                _types.push_back(TE_DATETIMETZ);
+            }
+            else if(t == "char")
+            {
+                _types.push_back(TE_CHAR);
+            }
             else if(t == "string")
             {
                 _types.push_back(TE_STRING);
@@ -163,6 +242,145 @@ private:
         }
     }
 
+    void setParamZip(vector<bool> keys)
+    {
+        _zip = keys[0];
+    }
+
+    void setParamSideCache(vector<bool> keys)
+    {
+        _sideCache = keys[0];
+    }
+
+    void setParamPartitionBy(vector<string> keys)
+    {
+        _partitionBy = keys[0];
+        if(_partitionBy.empty())
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "partition_by requires an attribute name";
+        }
+    }
+
+    void setParamOrderedBy(vector<string> keys)
+    {
+        _orderedBy = keys[0];
+        if(_orderedBy.empty())
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "ordered_by requires a dimension name";
+        }
+    }
+
+    static double checkProbability(double p, const char* kw)
+    {
+        if(!(p > 0 && p <= 1))
+        {
+            ostringstream error;
+            error<<kw<<" must be a probability greater than 0 and at most 1";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+        }
+        return p;
+    }
+
+    void setParamSample(vector<double> keys)
+    {
+        _sample = checkProbability(keys[0], KW_SAMPLE);
+    }
+
+    void setParamSampleChunks(vector<double> keys)
+    {
+        _sampleChunks = checkProbability(keys[0], KW_SAMPLE_CHUNKS);
+    }
+
+    void setParamSeed(vector<int64_t> keys)
+    {
+        _seed = keys[0];
+    }
+
+    void setParamInputCache(vector<bool> keys)
+    {
+        _inputCache = keys[0];
+    }
+
+    void setParamInputCacheMb(vector<int64_t> keys)
+    {
+        if(keys[0] <= 0)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "input_cache_mb must be positive";
+        }
+        _inputCacheMb = keys[0];
+    }
+
+    void setParamCache(vector<bool> keys)
+    {
+        _cache = keys[0];
+    }
+
+    void setParamCacheMb(vector<int64_t> keys)
+    {
+        if(keys[0] <= 0)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "cache_mb must be positive";
+        }
+        _cacheMb = keys[0];
+    }
+
+    void setParamInt64As(vector<string> keys)
+    {
+        if(keys[0] == "double")
+        {
+            _int64AsInteger64 = false;
+        }
+        else if(keys[0] == "integer64")
+        {
+            _int64AsInteger64 = true;
+        }
+        else
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "int64_as must be 'double' or 'integer64'";
+        }
+        if(_transferFormat != DF)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "int64_as is only supported with format:'df'";
+        }
+    }
+
+    void setParamCompression(vector<string> keys)
+    {
+        if(keys[0] != "lz4" && keys[0] != "zstd")
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "compression must be 'lz4' or 'zstd'";
+        }
+        if(_transferFormat != FEATHER)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "compression is only supported with format:'feather'";
+        }
+        _compression = keys[0];
+    }
+
+    void setParamDictionary(vector<string> keys)
+    {
+        if(keys[0] == "never")
+        {
+            _dictionary = DICTIONARY_NEVER;
+        }
+        else if(keys[0] == "auto")
+        {
+            _dictionary = DICTIONARY_AUTO;
+        }
+        else if(keys[0] == "always")
+        {
+            _dictionary = DICTIONARY_ALWAYS;
+        }
+        else
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "dictionary must be 'never', 'auto' or 'always'";
+        }
+        if(_transferFormat == TSV)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "dictionary is only supported with format:'df' or format:'feather'";
+        }
+    }
+
     void setKeywordParamString(KeywordParameters const& kwParams, const char* const kw, bool& alreadySet, void (Settings::* innersetter)(vector<string>) )
     {
         checkIfSet(alreadySet, kw);
@@ -212,6 +430,36 @@ private:
         }
     }
 
+    void setKeywordParamBool(KeywordParameters const& kwParams, const char* const kw, bool& alreadySet, void (Settings::* innersetter)(vector<bool>) )
+    {
+        checkIfSet(alreadySet, kw);
+
+        vector<bool> paramContent;
+        Parameter kwParam = getKeywordParam(kwParams, kw);
+        if (kwParam) {
+            paramContent.push_back(getParamContentBool(kwParam));
+            (this->*innersetter)(paramContent);
+            alreadySet = true;
+        } else {
+            LOG4CXX_DEBUG(logger, "Stream findKeyword null: " << kw);
+        }
+    }
+
+    void setKeywordParamDouble(KeywordParameters const& kwParams, const char* const kw, bool& alreadySet, void (Settings::* innersetter)(vector<double>) )
+    {
+        checkIfSet(alreadySet, kw);
+
+        vector<double> paramContent;
+        Parameter kwParam = getKeywordParam(kwParams, kw);
+        if (kwParam) {
+            paramContent.push_back(getParamContentDouble(kwParam));
+            (this->*innersetter)(paramContent);
+            alreadySet = true;
+        } else {
+            LOG4CXX_DEBUG(logger, "Stream findKeyword null: " << kw);
+        }
+    }
+
     string getParamContentString(Parameter& param)
     {
         string paramContent;
@@ -246,6 +494,30 @@ private:
         return paramContent;
     }
 
+    double getParamContentDouble(Parameter& param)
+    {
+        if(param->getParamType() == PARAM_LOGICAL_EXPRESSION) {
+            ParamType_t& paramExpr = reinterpret_cast<ParamType_t&>(param);
+            return evaluate(paramExpr->getExpression(), TID_DOUBLE).getDouble();
+        }
+        OperatorParamPhysicalExpression* exp =
+            dynamic_cast<OperatorParamPhysicalExpression*>(param.get());
+        SCIDB_ASSERT(exp != nullptr);
+        return exp->getExpression()->evaluate().getDouble();
+    }
+
+    bool getParamContentBool(Parameter& param)
+    {
+        if(param->getParamType() == PARAM_LOGICAL_EXPRESSION) {
+            ParamType_t& paramExpr = reinterpret_cast<ParamType_t&>(param);
+            return evaluate(paramExpr->getExpression(), TID_BOOL).getBool();
+        }
+        OperatorParamPhysicalExpression* exp =
+            dynamic_cast<OperatorParamPhysicalExpression*>(param.get());
+        SCIDB_ASSERT(exp != nullptr);
+        return exp->getExpression()->evaluate().getBool();
+    }
+
     Parameter getKeywordParam(KeywordParameters const& kwp, const std::string& kw) const
     {
         auto const& kwPair = kwp.find(kw);
@@ -270,11 +542,36 @@ public:
                  _transferFormat(TSV),
                  _types(0),
                  _outputChunkSize(1024*1024*1024),
-                 _chunkSizeSet(false)
+                 _chunkSizeSet(false),
+                 _zip(false),
+                 _sideCache(false),
+                 _sample(1),
+                 _sampleChunks(1),
+                 _seed(0),
+                 _inputCache(false),
+                 _inputCacheMb(1024),
+                 _cache(false),
+                 _cacheMb(1024),
+                 _int64AsInteger64(false),
+                 _dictionary(DICTIONARY_NEVER)
      {
         bool formatSet    = false;
         bool typesSet     = false;
         bool namesSet     = false;
+        bool zipSet       = false;
+        bool sideCacheSet = false;
+        bool partitionSet = false;
+        bool orderedSet   = false;
+        bool sampleSet    = false;
+        bool sampleChunksSet = false;
+        bool seedSet      = false;
+        bool inputCacheSet   = false;
+        bool inputCacheMbSet = false;
+        bool cacheSet     = false;
+        bool cacheMbSet   = false;
+        bool int64AsSet   = false;
+        bool compressionSet = false;
+        bool dictionarySet = false;
         size_t const nParams = operatorParameters.size();
 
         if (nParams > MAX_PARAMETERS)
@@ -288,6 +585,20 @@ public:
         setKeywordParamString(kwParams, KW_FORMAT, formatSet, &Settings::setParamFormat);
         setKeywordParamString(kwParams, KW_TYPES, typesSet, &Settings::setParamDfTypes);
         setKeywordParamString(kwParams, KW_NAMES, namesSet, &Settings::setParamDfNames);
+        setKeywordParamBool(kwParams, KW_ZIP, zipSet, &Settings::setParamZip);
+        setKeywordParamBool(kwParams, KW_SIDE_CACHE, sideCacheSet, &Settings::setParamSideCache);
+        setKeywordParamString(kwParams, KW_PARTITION_BY, partitionSet, &Settings::setParamPartitionBy);
+        setKeywordParamString(kwParams, KW_ORDERED_BY, orderedSet, &Settings::setParamOrderedBy);
+        setKeywordParamDouble(kwParams, KW_SAMPLE, sampleSet, &Settings::setParamSample);
+        setKeywordParamDouble(kwParams, KW_SAMPLE_CHUNKS, sampleChunksSet, &Settings::setParamSampleChunks);
+        setKeywordParamInt64(kwParams, KW_SEED, seedSet, &Settings::setParamSeed);
+        setKeywordParamBool(kwParams, KW_INPUT_CACHE, inputCacheSet, &Settings::setParamInputCache);
+        setKeywordParamInt64(kwParams, KW_INPUT_CACHE_MB, inputCacheMbSet, &Settings::setParamInputCacheMb);
+        setKeywordParamBool(kwParams, KW_CACHE, cacheSet, &Settings::setParamCache);
+        setKeywordParamInt64(kwParams, KW_CACHE_MB, cacheMbSet, &Settings::setParamCacheMb);
+        setKeywordParamString(kwParams, KW_INT64_AS, int64AsSet, &Settings::setParamInt64As);
+        setKeywordParamString(kwParams, KW_COMPRESSION, compressionSet, &Settings::setParamCompression);
+        setKeywordParamString(kwParams, KW_DICTIONARY, dictionarySet, &Settings::setParamDictionary);
 
     }
 
@@ -321,6 +632,112 @@ public:
         return _command;
     }
 
+    bool isZip() const
+    {
+        return _zip;
+    }
+
+    bool isSideCacheEnabled() const
+    {
+        return _sideCache;
+    }
+
+    /**
+     * @return the name of the attribute to partition the first input by, or empty if not partitioned
+     */
+    string const& getPartitionBy() const
+    {
+        return _partitionBy;
+    }
+
+    /**
+     * @return the name of the dimension to range-partition and order the first input by, or empty if not ordered
+     */
+    string const& getOrderedBy() const
+    {
+        return _orderedBy;
+    }
+
+    /**
+     * @return the probability to stream each cell of the first input; 1 if not sampled
+     */
+    double getSample() const
+    {
+        return _sample;
+    }
+
+    /**
+     * @return the probability to stream each chunk of the first input; 1 if not sampled
+     */
+    double getSampleChunks() const
+    {
+        return _sampleChunks;
+    }
+
+    int64_t getSeed() const
+    {
+        return _seed;
+    }
+
+    bool isSampled() const
+    {
+        return _sample < 1 || _sampleChunks < 1;
+    }
+
+    bool isInputCacheEnabled() const
+    {
+        return _inputCache;
+    }
+
+    /**
+     * @return the size limit of the input cache in bytes
+     */
+    size_t getInputCacheSize() const
+    {
+        return _inputCacheMb * 1024 * 1024;
+    }
+
+    /**
+     * @return true if the responses of the child are cached by the command and the messages they answer
+     */
+    bool isResultCacheEnabled() const
+    {
+        return _cache;
+    }
+
+    /**
+     * @return the size limit of the result cache in bytes
+     */
+    size_t getResultCacheSize() const
+    {
+        return _cacheMb * 1024 * 1024;
+    }
+
+    /**
+     * @return true if int64 attributes are sent to R as bit64 integer64 vectors rather than as doubles
+     */
+    bool isInt64AsInteger64() const
+    {
+        return _int64AsInteger64;
+    }
+
+    /**
+     * @return the codec that compresses the Arrow record batches sent to the child, 'lz4' or 'zstd', or empty if
+     * they are not compressed
+     */
+    string const& getCompression() const
+    {
+        return _compression;
+    }
+
+    /**
+     * @return whether string attributes are sent to the child dictionary-encoded, as Arrow dictionaries or R factors
+     */
+    DictionaryEncoding getDictionaryEncoding() const
+    {
+        return _dictionary;
+    }
+
 };
 
 } }
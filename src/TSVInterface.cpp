@@ -25,11 +25,16 @@
 
 #include "StreamSettings.h"
 #include "ChildProcess.h"
+#include "Sampler.h"
 #include <vector>
 #include <string>
 #include "TSVInterface.h"
+#include "TSVWriter.h"
 #include <array/MemArray.h>
 #include <query/Query.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using std::vector;
 using std::shared_ptr;
@@ -43,9 +48,42 @@ ArrayDesc TSVInterface::getOutputSchema(vector<ArrayDesc> const& inputSchemas, S
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "TSV interface invoked on improper format";
     }
-    if(settings.getTypes().size())
+    vector<TypeEnum> const& outputTypes = settings.getTypes();
+    if(outputTypes.size())
     {
-        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "TSV interface does not support the types parameter";
+        vector<string> outputNames = settings.getNames();
+        if(outputNames.size() == 0)
+        {
+            for(size_t i =0; i<outputTypes.size(); ++i)
+            {
+                ostringstream name;
+                name<<"a"<<i;
+                outputNames.push_back(name.str());
+            }
+        }
+        else if (outputNames.size() != outputTypes.size())
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received inconsistent names and types";
+        }
+        Dimensions outputDimensions;
+        outputDimensions.push_back(DimensionDesc("instance_id", 0,   query->getInstancesCount()-1, 1, 0));
+        outputDimensions.push_back(DimensionDesc("chunk_no",    0,   CoordinateBounds::getMax(),   1, 0));
+        outputDimensions.push_back(DimensionDesc("value_no",    0,   CoordinateBounds::getMax(),   settings.getChunkSize(), 0));
+        Attributes outputAttributes;
+        for(AttributeID i =0; i<outputTypes.size(); ++i)
+        {
+            if(outputTypes[i] == TE_BINARY)
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "TSV interface does not support binary output";
+            }
+            if(outputTypes[i] != TE_INT32 && outputTypes[i] != TE_INT64 && outputTypes[i] != TE_DOUBLE && outputTypes[i] != TE_STRING)
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "TSV interface supports only int32, int64, double and string output";
+            }
+            outputAttributes.push_back( AttributeDesc(outputNames[i], typeEnum2TypeId(outputTypes[i]), AttributeDesc::IS_NULLABLE, CompressorType::NONE));
+        }
+        outputAttributes.addEmptyTagAttribute();
+        return ArrayDesc(inputSchemas[0].getName(), outputAttributes, outputDimensions, createDistribution(dtUndefined), query->getDefaultArrayResidency());
     }
     if(settings.isChunkSizeSet())
     {
@@ -64,20 +102,41 @@ ArrayDesc TSVInterface::getOutputSchema(vector<ArrayDesc> const& inputSchemas, S
     return ArrayDesc(inputSchemas[0].getName(), outputAttributes, outputDimensions, createDistribution(dtUndefined), query->getDefaultArrayResidency());
 }
 
-TSVInterface::TSVInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query):
+TSVInterface::TSVInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query,
+                           BufferArena& arena):
     _attDelim(  '\t'),
     _lineDelim( '\n'),
     _printCoords(false),
+    _typed(settings.getTypes().size() > 0),
     _nanRepresentation("nan"),
     _nullRepresentation("\\N"),
     _query(query),
     _result(new MemArray(outputSchema, query)),
-    _aiter(_result->getIterator(outputSchema.getAttributes(true).firstDataAttribute())),
-    _outPos{ ((Coordinate) _query->getInstanceID()), 0}
-{}
+    _outPos{ ((Coordinate) _query->getInstanceID()), 0},
+    _sampler(NULL),
+    _stopRequested(false),
+    _arena(arena),
+    _readBuf(arena.acquire(1024*1024))
+{
+    _nullVal.setNull();
+    if(!_typed)
+    {
+        _aiter = _result->getIterator(outputSchema.getAttributes(true).firstDataAttribute());
+        return;
+    }
+    _outPos.push_back(0);
+    for (const auto& attr : outputSchema.getAttributes(true))
+    {
+        _oaiters.push_back(_result->getIterator(attr));
+        _outputNames.push_back(attr.getName());
+    }
+    _oaiters.push_back(_result->getIterator(*outputSchema.getEmptyBitmapAttribute()));
+    _outputTypes = settings.getTypes();
+}
 
-void TSVInterface::setInputSchema(ArrayDesc const& inputSchema)
+void TSVInterface::setInputSchema(ArrayDesc const& inputSchema, Sampler const* sampler)
 {
+    _sampler = sampler;
     Attributes const& attrs = inputSchema.getAttributes(true);
     _inputTypes.resize(attrs.size());
     _inputConverters.resize(attrs.size());
@@ -92,8 +151,14 @@ void TSVInterface::setInputSchema(ArrayDesc const& inputSchema)
         case TE_BOOL:
         case TE_DOUBLE:
         case TE_FLOAT:
-        case TE_UINT8:
+        case TE_INT64:
+        case TE_INT32:
+        case TE_INT16:
         case TE_INT8:
+        case TE_UINT64:
+        case TE_UINT32:
+        case TE_UINT16:
+        case TE_UINT8:
             _inputConverters[i] = NULL;
             break;
         default:
@@ -106,67 +171,113 @@ void TSVInterface::setInputSchema(ArrayDesc const& inputSchema)
     }
 }
 
-void TSVInterface::streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child)
+bool TSVInterface::convertChunks(std::vector<ConstChunk const*> const& inputChunks, size_t &nCells, BufferArena::Buffer& output)
 {
     if(inputChunks.size() != _inputTypes.size())
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "received inconsistent number of input chunks";
     }
-    if(inputChunks[0]->count() == 0)
-    {
-        return;
-    }
-    if(!child.isAlive())
+    _mask.clear();
+    size_t const nKept = _sampler ? _sampler->maskChunk(*inputChunks[0], _mask) : inputChunks[0]->count();
+    if(nKept == 0)
     {
-        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "child exited early";
+        return false;
     }
     vector<shared_ptr<ConstChunkIterator> > citers(inputChunks.size());
-    size_t nCells;
-    string output;
     for(size_t i =0, n= _inputTypes.size(); i<n; ++i)
     {
         citers[i] = inputChunks[i]->getConstIterator(ConstChunkIterator::IGNORE_OVERLAPS);
     }
+    output.reserve(nKept * _inputTypes.size() * 8);  // a rough guess that saves most of the regrowth
     convertChunks(citers, nCells, output);
-    writeTSV(nCells, output, child);
-    readTSV(output, child);
-    if(output.size() > MAX_RESPONSE_SIZE)
+    return true;
+}
+
+void TSVInterface::streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child)
+{
+    size_t nCells;
+    BufferArena::Buffer output = _arena.acquire(BufferArena::MIN_POOLED_BYTES);
+    if(!convertChunks(inputChunks, nCells, output))
     {
-        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "response from child exceeds maximum size";
+        return;
     }
-    if(output.size())
+    if(!child.isAlive())
     {
-        output.resize(output.size()-1);
-        addChunkToArray(output);
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "child exited early";
     }
+    writeTSV(nCells, output.data(), output.size(), child);
+    readResponse(child);
 }
 
-shared_ptr<Array> TSVInterface::finalize(ChildProcess& child)
+bool TSVInterface::encodeData(std::vector<ConstChunk const*> const& inputChunks, MessageRecorder& recorder)
 {
-    writeTSV(0, "", child);
-    string output;
-    readTSV(output, child, true);
-    if(output.size() > MAX_RESPONSE_SIZE)
+    size_t nCells;
+    BufferArena::Buffer output = _arena.acquire(BufferArena::MIN_POOLED_BYTES);
+    if(!convertChunks(inputChunks, nCells, output))
     {
-        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "response from child exceeds maximum size";
+        return false;
     }
-    if(output.size())
+    writeTSV(nCells, output.data(), output.size(), recorder);
+    return true;
+}
+
+void TSVInterface::streamEncoded(std::vector<char> const& message, ChildProcess& child)
+{
+    if(!child.isAlive())
     {
-        output.resize(output.size()-1);
-        addChunkToArray(output);
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "child exited early";
     }
+    child.hardWrite(message.data(), message.size());
+    readResponse(child);
+}
+
+shared_ptr<Array> TSVInterface::finalize(ChildProcess& child)
+{
+    writeTSV(0, "", 0, child);
+    readResponse(child, true);
     _aiter.reset();
+    _oaiters.clear();
     return _result;
 }
 
+void TSVInterface::readResponse(ChildProcess& child, bool last)
+{
+    BufferArena::Buffer& buf = _readBuf;
+    size_t tsvStart;
+    readTSV(buf, tsvStart, child, last);
+    size_t const outputSize = buf.size() - tsvStart;
+    if(outputSize > MAX_RESPONSE_SIZE)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "response from child exceeds maximum size";
+    }
+    if(outputSize && _typed)
+    {
+        addRowsToArray(buf.data() + tsvStart, outputSize);
+    }
+    else if(outputSize)
+    {
+        buf[buf.size()-1] = 0; // the final newline becomes the string terminator
+        addChunkToArray(buf.data() + tsvStart, outputSize);
+    }
+}
+
 
-void TSVInterface::convertChunks(vector< shared_ptr<ConstChunkIterator> > citers, size_t &nCells, string& output)
+void TSVInterface::convertChunks(vector< shared_ptr<ConstChunkIterator> > citers, size_t &nCells, BufferArena::Buffer& outputBuf)
 {
     Value stringVal;
     nCells = 0;
-    ostringstream outputBuf;
-    while(!citers[0]->end())
+    outputBuf.clear();
+    TSVWriter out(outputBuf);
+    for(size_t cell = 0; !citers[0]->end(); ++cell)
     {
+        if(!Sampler::keeps(_mask, cell))
+        {
+            for(size_t i = 0, n=citers.size(); i<n; ++i)
+            {
+                ++(*citers[i]);
+            }
+            continue;
+        }
         if(_printCoords)
         {
             Coordinates const& pos = citers[0]->getPosition();
@@ -174,9 +285,9 @@ void TSVInterface::convertChunks(vector< shared_ptr<ConstChunkIterator> > citers
             {
                 if(i)
                 {
-                    outputBuf<<_attDelim;
+                    out.appendChar(_attDelim);
                 }
-                outputBuf<<pos[i];
+                out.appendInt(pos[i]);
             }
         }
         for (size_t i = 0, n=citers.size(); i < n; ++i)
@@ -184,11 +295,11 @@ void TSVInterface::convertChunks(vector< shared_ptr<ConstChunkIterator> > citers
             Value const& v = citers[i]->getItem();
             if (i || _printCoords)
             {
-                outputBuf<<_attDelim;
+                out.appendChar(_attDelim);
             }
             if(v.isNull())
             {
-                outputBuf<<_nullRepresentation; //TODO: note all missing codes are converted to this representation
+                out.appendRaw(_nullRepresentation); //TODO: note all missing codes are converted to this representation
             }
             else
             {
@@ -196,53 +307,23 @@ void TSVInterface::convertChunks(vector< shared_ptr<ConstChunkIterator> > citers
                 {
                 case TE_STRING:
                     {
-                        char const* s = v.getString();
-                        while (char c = *s++)
-                        {
-                            if (c == '\n')
-                            {
-                                outputBuf << "\\n";
-                            }
-                            else if (c == '\t')
-                            {
-                                outputBuf << "\\t";
-                            }
-                            else if (c == '\r')
-                            {
-                                outputBuf << "\\r";
-                            }
-                            else if (c == '\\')
-                            {
-                                outputBuf << "\\\\";
-                            }
-                            else
-                            {
-                                outputBuf << c;
-                            }
-                        }
+                        char const* str = v.getString();
+                        out.appendEscaped(str, strlen(str));
                     }
                     break;
                 case TE_BOOL:
-                    if(v.getBool())
-                    {
-                        outputBuf<<"true";
-                    }
-                    else
-                    {
-                        outputBuf<<"false";
-                    }
+                    out.appendBool(v.getBool());
                     break;
                 case TE_DOUBLE:
                     {
                         double nbr =v.getDouble();
                         if(std::isnan(nbr))
                         {
-                            outputBuf<<_nanRepresentation;
+                            out.appendRaw(_nanRepresentation);
                         }
                         else
                         {
-                            outputBuf.precision(std::numeric_limits<double>::max_digits10);
-                            outputBuf<<nbr;
+                            out.appendDouble(nbr);
                         }
                     }
                     break;
@@ -251,63 +332,93 @@ void TSVInterface::convertChunks(vector< shared_ptr<ConstChunkIterator> > citers
                         float fnbr =v.getFloat();
                         if(std::isnan(fnbr))
                         {
-                            outputBuf<<_nanRepresentation;
+                            out.appendRaw(_nanRepresentation);
                         }
                         else
                         {
-                            outputBuf.precision(std::numeric_limits<float>::max_digits10);
-                            outputBuf<<fnbr;
+                            out.appendFloat(fnbr);
                         }
                     }
                     break;
-                case TE_UINT8:
-                    {
-                        uint8_t nbr =v.getUint8();
-                        outputBuf<<(int16_t) nbr;
-                    }
-                    break;
-                case TE_INT8:
-                    {
-                        int8_t nbr =v.getUint8();
-                        outputBuf<<(int16_t) nbr;
-                    }
-                    break;
+                case TE_INT64:  out.appendInt(v.getInt64());   break;
+                case TE_INT32:  out.appendInt(v.getInt32());   break;
+                case TE_INT16:  out.appendInt(v.getInt16());   break;
+                case TE_INT8:   out.appendInt(v.getInt8());    break;
+                case TE_UINT64: out.appendUint(v.getUint64()); break;
+                case TE_UINT32: out.appendUint(v.getUint32()); break;
+                case TE_UINT16: out.appendUint(v.getUint16()); break;
+                case TE_UINT8:  out.appendUint(v.getUint8());  break;
                 default:
                     {
                         Value const * vv = &v;
                         (*_inputConverters[i])(&vv, &stringVal, NULL);
-                        outputBuf<<stringVal.getString();
+                        char const* str = stringVal.getString();
+                        out.appendRaw(str, strlen(str));
                     }
                 }
             }
         }
-        outputBuf<<_lineDelim;
+        out.appendChar(_lineDelim);
         ++nCells;
         for(size_t i = 0, n=citers.size(); i<n; ++i)
         {
             ++(*citers[i]);
         }
     }
-    output = outputBuf.str();
 }
 
-void TSVInterface::writeTSV(size_t const nLines, string const& inputData, ChildProcess& child)
+template <class OUTPUT>
+void TSVInterface::writeTSV(size_t const nLines, char const* inputData, size_t const inputSize, OUTPUT& out)
 {
-    LOG4CXX_DEBUG(logger, "Input of stream: "<< inputData);
+    LOG4CXX_DEBUG(logger, "Input of stream: "<< string(inputData, inputSize));
     char hdr[4096];
     snprintf (hdr, 4096, "%lu\n", nLines);
     size_t n = strlen (hdr);
-    child.hardWrite (hdr, n);
-    if(n>0)
+    _message.append(hdr, n);
+    _message.appendRef(inputData, inputSize);
+    _message.flush(out);
+}
+
+char const* const TSVInterface::STOP_MARKER = "\tSTOP";
+
+/**
+ * Count newlines in [begin, end) until wanted of them are found, adding them to nLines.
+ * @return the position just past the last newline counted if all were found, end otherwise
+ */
+static char const* countLines(char const* begin, char const* end, int64_t wanted, int64_t& nLines)
+{
+    char const* p = begin;
+#ifdef __SSE2__
+    // whole blocks are counted only while they cannot contain more newlines than wanted
+    __m128i const newline = _mm_set1_epi8('\n');
+    int64_t found = 0;
+    while(end - p >= 16 && wanted - found > 16)
     {
-        child.hardWrite (inputData.c_str(), inputData.size());
+        __m128i const v = _mm_loadu_si128((__m128i const*) p);
+        found += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        p += 16;
+    }
+    nLines += found;
+    wanted -= found;
+#endif
+    while(wanted > 0)
+    {
+        char const* next = (char const*) memchr(p, '\n', end - p);
+        if(next == NULL)
+        {
+            return end;
+        }
+        ++nLines;
+        --wanted;
+        p = next + 1;
     }
+    return p;
 }
 
-void TSVInterface::readTSV (std::string& output, ChildProcess& child, bool last)
+void TSVInterface::readTSV (BufferArena::Buffer& buf, size_t& tsvStart, ChildProcess& child, bool last)
 {
-    size_t bufSize = 1024*1024;
-    vector<char> buf(bufSize);
+    size_t bufSize = buf.capacity();
+    buf.resize(bufSize);
     size_t dataSize = child.softRead( &(buf[0]), bufSize, !last);
     size_t idx =0;
     while ( idx < dataSize && buf[idx] != '\n')
@@ -321,6 +432,11 @@ void TSVInterface::readTSV (std::string& output, ChildProcess& child, bool last)
     char* end = &(buf[0]);
     errno = 0;
     int64_t expectedNumLines = strtoll(&(buf[0]), &end, 10);
+    if(strncmp(end, STOP_MARKER, strlen(STOP_MARKER)) == 0)
+    {
+        _stopRequested = true;
+        end += strlen(STOP_MARKER);
+    }
     if(*end != '\n' || (size_t) (end - &(buf[0])) != idx || errno !=0 || expectedNumLines < 0)
     {
         LOG4CXX_DEBUG(logger, "Got this stuff "<<(&buf[0]));
@@ -331,14 +447,7 @@ void TSVInterface::readTSV (std::string& output, ChildProcess& child, bool last)
     int64_t linesReceived = 0;
     while(linesReceived < expectedNumLines)
     {
-        while(idx < dataSize && linesReceived < expectedNumLines)
-        {
-            if(buf[idx] == '\n')
-            {
-                ++linesReceived;
-            }
-            ++idx;
-        }
+        idx = countLines(buf.data() + idx, buf.data() + dataSize, expectedNumLines - linesReceived, linesReceived) - buf.data();
         LOG4CXX_DEBUG(logger, "linesReceived: "<< linesReceived);
         if(linesReceived < expectedNumLines)
         {
@@ -358,17 +467,189 @@ void TSVInterface::readTSV (std::string& output, ChildProcess& child, bool last)
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "child did not end message with newline";
     }
-    output.assign( &(buf[tsvStartIdx]), dataSize - tsvStartIdx);
+    buf.resize(dataSize);
+    tsvStart = tsvStartIdx;
 }
 
-void TSVInterface::addChunkToArray(string const& output)
+void TSVInterface::addChunkToArray(char const* output, size_t const size)
 {
     shared_ptr<ChunkIterator> citer = _aiter->newChunk(_outPos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE);
     citer->setPosition(_outPos);
-    _stringBuf.setString(output);
+    // the chunk takes its items as Values, so the response is copied into _stringBuf, which keeps its allocation
+    // between responses, and again into the chunk
+    _stringBuf.setData(output, size);
     citer->writeItem(_stringBuf);
     citer->flush();
     _outPos[1]++;
 }
 
+/**
+ * Record the offset of every tab and newline in [begin, end), 16 bytes at a time with SSE2 where available.
+ */
+static void findDelimiters(char const* begin, char const* end, vector<uint32_t>& delims)
+{
+    delims.clear();
+    char const* p = begin;
+#ifdef __SSE2__
+    __m128i const tab     = _mm_set1_epi8('\t');
+    __m128i const newline = _mm_set1_epi8('\n');
+    while(end - p >= 16)
+    {
+        __m128i const v = _mm_loadu_si128((__m128i const*) p);
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, newline)));
+        while(mask)
+        {
+            delims.push_back((uint32_t) (p - begin) + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for(; p < end; ++p)
+    {
+        if(*p == '\t' || *p == '\n')
+        {
+            delims.push_back((uint32_t) (p - begin));
+        }
+    }
+}
+
+void TSVInterface::parseError(size_t line, size_t column, char const* field, char const* fieldEnd, char const* expected) const
+{
+    ostringstream error;
+    error<<"TSV response "<<_outPos[1]<<" line "<<line+1<<" column "<<column+1;
+    if(column < _outputNames.size())
+    {
+        error<<" ("<<_outputNames[column]<<")";
+    }
+    error<<": "<<expected;
+    if(field)
+    {
+        size_t const size = fieldEnd - field;
+        error<<", got '"<<string(field, size < 64 ? size : 64)<<(size < 64 ? "'" : "...'");
+    }
+    throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+}
+
+void TSVInterface::addRowsToArray(char const* output, size_t const size)
+{
+    findDelimiters(output, output + size, _delims);
+    size_t const nColumns = _outputTypes.size();
+    vector<shared_ptr<ChunkIterator> > ociters(nColumns + 1);
+    for(size_t i = 0; i<=nColumns; ++i)
+    {
+        ociters[i] = _oaiters[i]->newChunk(_outPos).getIterator(_query, ChunkIterator::SEQUENTIAL_WRITE | ChunkIterator::NO_EMPTY_CHECK);
+    }
+    Value bmVal;
+    bmVal.setBool(true);
+    Coordinates valPos = _outPos;
+    string unescaped;
+    size_t fieldStart = 0;
+    size_t column = 0;
+    size_t line = 0;
+    for(size_t d = 0, nDelims = _delims.size(); d<nDelims; ++d)
+    {
+        size_t const fieldEnd = _delims[d];
+        bool const endOfLine = output[fieldEnd] == '\n';
+        char const* field = output + fieldStart;
+        char const* fieldStop = output + fieldEnd;
+        if(column >= nColumns)
+        {
+            parseError(line, column, NULL, NULL, "too many fields");
+        }
+        if(endOfLine && column + 1 < nColumns)
+        {
+            parseError(line, column + 1, NULL, NULL, "too few fields");
+        }
+        ociters[column]->setPosition(valPos);
+        if(fieldEnd - fieldStart == 2 && field[0] == '\\' && field[1] == 'N')
+        {
+            ociters[column]->writeItem(_nullVal);
+        }
+        else
+        {
+            switch(_outputTypes[column])
+            {
+            case TE_STRING:
+            {
+                unescaped.clear();
+                for(char const* c = field; c < fieldStop; ++c)
+                {
+                    if(*c == '\\' && c + 1 < fieldStop)
+                    {
+                        ++c;
+                        switch(*c)
+                        {
+                        case 'n':  unescaped.push_back('\n'); break;
+                        case 't':  unescaped.push_back('\t'); break;
+                        case 'r':  unescaped.push_back('\r'); break;
+                        default:   unescaped.push_back(*c);   break;
+                        }
+                    }
+                    else
+                    {
+                        unescaped.push_back(*c);
+                    }
+                }
+                _val.setString(unescaped);
+                break;
+            }
+            case TE_DOUBLE:
+            {
+                char* end = NULL;
+                double const v = strtod(field, &end);
+                if(end != fieldStop || field == fieldStop)
+                {
+                    parseError(line, column, field, fieldStop, "expected a double");
+                }
+                _val.setDouble(v);
+                break;
+            }
+            case TE_INT32:
+            case TE_INT64:
+            {
+                char* end = NULL;
+                errno = 0;
+                int64_t const v = strtoll(field, &end, 10);
+                if(end != fieldStop || field == fieldStop || errno != 0)
+                {
+                    parseError(line, column, field, fieldStop, "expected an integer");
+                }
+                if(_outputTypes[column] == TE_INT32)
+                {
+                    if(v < std::numeric_limits<int32_t>::min() || v > std::numeric_limits<int32_t>::max())
+                    {
+                        parseError(line, column, field, fieldStop, "integer out of int32 range");
+                    }
+                    _val.setInt32((int32_t) v);
+                }
+                else
+                {
+                    _val.setInt64(v);
+                }
+                break;
+            }
+            default:
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "internal error: unknown type";
+            }
+            ociters[column]->writeItem(_val);
+        }
+        fieldStart = fieldEnd + 1;
+        ++column;
+        if(endOfLine)
+        {
+            ociters[nColumns]->setPosition(valPos);
+            ociters[nColumns]->writeItem(bmVal);
+            ++valPos[2];
+            column = 0;
+            ++line;
+        }
+    }
+    for(size_t i = 0; i<=nColumns; ++i)
+    {
+        ociters[i]->flush();
+    }
+    _outPos[1]++;
+}
+
 }}
@@ -28,12 +28,16 @@
 
 #include <query/PhysicalOperator.h>
 #include <query/TypeSystem.h>
+#include "BufferArena.h"
+#include "MessageBuilder.h"
 
 namespace scidb { namespace stream
 {
 
 class Settings;
 class ChildProcess;
+class MessageRecorder;
+class Sampler;
 
 /**
  * Interface for streaming data in TSV format. Converts SciDB data to TSV and then communicates with the child process.
@@ -48,6 +52,13 @@ class ChildProcess;
  *
  * 0
  *
+ * The child may follow the number of lines in a response with a tab and STOP, like "3\tSTOP", to ask not to be sent
+ * any more data; the final empty message is still sent.
+ *
+ * By default each response is stored whole as one string cell at [instance_id, chunk_no]. When output types are
+ * given, each response line is parsed instead into one cell at [instance_id, chunk_no, value_no] with one typed,
+ * nullable attribute per field, like the DF and Feather interfaces produce; \N is null and strings are unescaped.
+ *
  * Some nuances are still not solidified: how to output SciDB NULL codes, or whether strings be quoted and tabs inside
  * strings should be escaped. See the Ctor or the Settings class for some defaults. Couldn't easily reuse any existing
  * SciDB components for the TSV conversion so, sadly, implemented our own TSV conversion here. Upside: more flexibility
@@ -73,15 +84,27 @@ public:
      * @param settings the settings of the operator
      * @param outputSchema must be the result of a previous getOutputSchema call for these settings
      * @param query the query context
+     * @param arena the session buffer arena to draw conversion buffers from; must outlive the interface
      */
-    TSVInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query);
+    TSVInterface(Settings const& settings, ArrayDesc const& outputSchema, std::shared_ptr<Query> const& query,
+                 BufferArena& arena);
 
     /**
      * Set the interface to stream chunks from a given array. Must be called before streamData, when first
      * starting to stream and whenever the array that chunks are streamed from changes
      * @param inputSchema the schema of the array whose chunks will be streamed
+     * @param sampler if not NULL, only the cells it keeps are streamed; must outlive the streaming of the array
      */
-    void setInputSchema(ArrayDesc const& inputSchema);
+    void setInputSchema(ArrayDesc const& inputSchema, Sampler const* sampler = NULL);
+
+    /**
+     * @return what the result cache must know of the input schema besides the messages: nothing, as the child sees
+     * only the text of each message
+     */
+    std::string getInputSchemaKey() const
+    {
+        return std::string();
+    }
 
     /**
      * Write data to the child and record the response into an internal array.
@@ -91,6 +114,45 @@ public:
      */
     void streamData(std::vector<ConstChunk const*> const& inputChunks, ChildProcess& child);
 
+    /**
+     * Encode the message that streamData would send for the given chunks, without sending it or reading a response.
+     * @param inputChunks the data must match the attributes from the most recent setInputSchema call,
+     *                    excluding the empty tag.
+     * @param recorder the destination of the encoded message
+     * @return false if the chunks are empty and there is no message to send
+     */
+    bool encodeData(std::vector<ConstChunk const*> const& inputChunks, MessageRecorder& recorder);
+
+    /**
+     * Write a message previously produced by encodeData to the child and record the response into an internal array.
+     * @param message the encoded message, for the attributes of the most recent setInputSchema call
+     * @param child the process to stream to
+     */
+    void streamEncoded(std::vector<char> const& message, ChildProcess& child);
+
+    /**
+     * Read the response of the child to a message, or a response replayed by the child, into the internal array.
+     * @param child the process to read from
+     * @param last true when reading the response to the final zero-length message
+     */
+    void readResponse(ChildProcess& child, bool last = false);
+
+    /**
+     * @return true, as TSV responses are plain text that decodes on its own when replayed from the result cache
+     */
+    bool isResponseCacheable() const
+    {
+        return true;
+    }
+
+    /**
+     * @return true if a response from the child asked not to be sent any more data
+     */
+    bool isStopRequested() const
+    {
+        return _stopRequested;
+    }
+
     /**
      * Finish the interaction, write the terminating message to the child and return a pointer to the array
      * containing all the accumulated result data. This object is invalidated after this call.
@@ -101,24 +163,46 @@ public:
 
     static size_t const MAX_RESPONSE_SIZE = 1024*1024*1024;
 
+    /**
+     * Follows the number of lines in a response that asks to stop.
+     */
+    static char const* const STOP_MARKER;
+
 private:
     char const                     _attDelim;
     char const                     _lineDelim;
     bool const                     _printCoords;
+    bool const                     _typed;
     std::string                    _nanRepresentation;
     std::string                    _nullRepresentation;
     std::shared_ptr<Query>         _query;
     std::shared_ptr<Array>         _result;
     std::shared_ptr<ArrayIterator> _aiter;
+    std::vector<std::shared_ptr<ArrayIterator> > _oaiters;
+    std::vector<TypeEnum>          _outputTypes;
+    std::vector<std::string>       _outputNames;
+    std::vector<uint32_t>          _delims;
     Coordinates                    _outPos;
     std::vector <TypeEnum>         _inputTypes;
     std::vector<FunctionPointer>   _inputConverters;
     Value                          _stringBuf;
-
-    void convertChunks(std::vector< std::shared_ptr<ConstChunkIterator> > citers, size_t &nCells, std::string& output);
-    void writeTSV(size_t const nLines, std::string const& inputData, ChildProcess& child);
-    void readTSV (std::string& output, ChildProcess& child, bool last = false);
-    void addChunkToArray(std::string const& output);
+    Value                          _val;
+    Value                          _nullVal;
+    Sampler const*                 _sampler;
+    std::vector<char>              _mask;
+    bool                           _stopRequested;
+    BufferArena&                   _arena;
+    BufferArena::Buffer            _readBuf;
+    MessageBuilder                 _message;
+
+    bool convertChunks(std::vector<ConstChunk const*> const& inputChunks, size_t &nCells, BufferArena::Buffer& output);
+    void convertChunks(std::vector< std::shared_ptr<ConstChunkIterator> > citers, size_t &nCells, BufferArena::Buffer& output);
+    template <class OUTPUT>
+    void writeTSV(size_t const nLines, char const* inputData, size_t const inputSize, OUTPUT& out);
+    void readTSV (BufferArena::Buffer& buf, size_t& tsvStart, ChildProcess& child, bool last = false);
+    void addChunkToArray(char const* output, size_t const size);
+    void addRowsToArray(char const* output, size_t const size);
+    void parseError(size_t line, size_t column, char const* field, char const* fieldEnd, char const* expected) const;
 };
 
 }}
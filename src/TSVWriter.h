@@ -0,0 +1,263 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* stream is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* stream is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* stream is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with stream.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SRC_TSVWRITER_H_
+#define SRC_TSVWRITER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "BufferArena.h"
+#include "../extern/grisu/grisu2.h"
+
+namespace scidb { namespace stream
+{
+
+/**
+ * Appends TSV fields straight into an arena buffer. Floating point numbers are printed with the fewest significant
+ * digits that read back to the same value, so 0.1 is written as 0.1 rather than 0.10000000000000001; the digits come
+ * from Grisu2 in one pass, without printf or trial parses, and are the fewest for all but about one value in a
+ * thousand, which gets one more. Strings are
+ * scanned for the characters that need escaping 16 bytes at a time with SSE2 where available, and the runs between
+ * them are copied in bulk.
+ */
+class TSVWriter
+{
+public:
+    explicit TSVWriter(BufferArena::Buffer& buf):
+        _buf(buf)
+    {}
+
+    void appendChar(char c)
+    {
+        _buf.append(c);
+    }
+
+    void appendRaw(char const* data, size_t size)
+    {
+        _buf.append(data, size);
+    }
+
+    void appendRaw(std::string const& s)
+    {
+        _buf.append(s.data(), s.size());
+    }
+
+    void appendBool(bool b)
+    {
+        if(b)
+        {
+            _buf.append("true", 4);
+        }
+        else
+        {
+            _buf.append("false", 5);
+        }
+    }
+
+    void appendInt(int64_t v)
+    {
+        uint64_t u = v;
+        if(v < 0)
+        {
+            _buf.append('-');
+            u = 0 - u;
+        }
+        appendUint(u);
+    }
+
+    void appendUint(uint64_t v)
+    {
+        char digits[20];
+        char* p = digits + sizeof(digits);
+        do
+        {
+            *--p = '0' + (v % 10);
+            v /= 10;
+        } while(v);
+        _buf.append(p, digits + sizeof(digits) - p);
+    }
+
+    void appendDouble(double v)
+    {
+        char* out = _buf.prepareAppend(MAX_NUMBER_SIZE);
+        _buf.commitAppend(formatShortest(v, 15, out));
+    }
+
+    void appendFloat(float v)
+    {
+        char* out = _buf.prepareAppend(MAX_NUMBER_SIZE);
+        _buf.commitAppend(formatShortest(v, 6, out));
+    }
+
+    /**
+     * Append a string, writing newline, tab, carriage return and backslash as \n, \t, \r and \\.
+     */
+    void appendEscaped(char const* s, size_t size)
+    {
+        char const* const end = s + size;
+        while(s < end)
+        {
+            char const* special = findSpecial(s, end);
+            _buf.append(s, special - s);
+            if(special == end)
+            {
+                return;
+            }
+            char escaped[2] = { '\\', *special };
+            switch(*special)
+            {
+            case '\n': escaped[1] = 'n'; break;
+            case '\t': escaped[1] = 't'; break;
+            case '\r': escaped[1] = 'r'; break;
+            default:   break;
+            }
+            _buf.append(escaped, 2);
+            s = special + 1;
+        }
+    }
+
+private:
+    static size_t const MAX_NUMBER_SIZE = 32;
+
+    BufferArena::Buffer& _buf;
+
+    /**
+     * Print v in the layout of printf %.Pg, with the digits from Grisu2 and P the larger of minPrecision and their
+     * number, so that the output is what the first %g precision from minPrecision up that reads back to v would
+     * print, save for the rare values where Grisu2 gives one digit more than needed.
+     * @return the number of characters written, at most MAX_NUMBER_SIZE
+     */
+    template <typename T>
+    static size_t formatShortest(T v, int minPrecision, char* out)
+    {
+        char* p = out;
+        if(std::signbit(v))
+        {
+            *p++ = '-';
+            v = -v;
+        }
+        if(v == 0)
+        {
+            *p++ = '0';
+            return p - out;
+        }
+        if(std::isinf(v))
+        {
+            memcpy(p, "inf", 3);
+            return p + 3 - out;
+        }
+        char digits[MAX_NUMBER_SIZE];
+        int k;
+        int const n = grisu2::Grisu2(v, digits, &k);
+        int const exponent = k + n - 1;
+        if(exponent < -4 || exponent >= std::max(minPrecision, n))
+        {
+            *p++ = digits[0];
+            if(n > 1)
+            {
+                *p++ = '.';
+                memcpy(p, digits + 1, n - 1);
+                p += n - 1;
+            }
+            *p++ = 'e';
+            *p++ = exponent < 0 ? '-' : '+';
+            int const e = exponent < 0 ? -exponent : exponent;
+            if(e >= 100)
+            {
+                *p++ = '0' + e / 100;
+            }
+            *p++ = '0' + e / 10 % 10;
+            *p++ = '0' + e % 10;
+        }
+        else if(exponent < 0)
+        {
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', -exponent - 1);
+            p += -exponent - 1;
+            memcpy(p, digits, n);
+            p += n;
+        }
+        else if(n <= exponent + 1)
+        {
+            memcpy(p, digits, n);
+            p += n;
+            memset(p, '0', exponent + 1 - n);
+            p += exponent + 1 - n;
+        }
+        else
+        {
+            memcpy(p, digits, exponent + 1);
+            p += exponent + 1;
+            *p++ = '.';
+            memcpy(p, digits + exponent + 1, n - exponent - 1);
+            p += n - exponent - 1;
+        }
+        return p - out;
+    }
+
+    static bool isSpecial(char c)
+    {
+        return c == '\n' || c == '\t' || c == '\r' || c == '\\';
+    }
+
+    static char const* findSpecial(char const* s, char const* end)
+    {
+#ifdef __SSE2__
+        __m128i const newline   = _mm_set1_epi8('\n');
+        __m128i const tab       = _mm_set1_epi8('\t');
+        __m128i const cr        = _mm_set1_epi8('\r');
+        __m128i const backslash = _mm_set1_epi8('\\');
+        while(end - s >= 16)
+        {
+            __m128i const v = _mm_loadu_si128((__m128i const*) s);
+            __m128i const hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, tab)),
+                                              _mm_or_si128(_mm_cmpeq_epi8(v, cr),      _mm_cmpeq_epi8(v, backslash)));
+            int const mask = _mm_movemask_epi8(hits);
+            if(mask)
+            {
+                return s + __builtin_ctz(mask);
+            }
+            s += 16;
+        }
+#endif
+        while(s < end && !isSpecial(*s))
+        {
+            ++s;
+        }
+        return s;
+    }
+};
+
+}}
+
+#endif /* SRC_TSVWRITER_H_ */
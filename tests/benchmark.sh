@@ -0,0 +1,105 @@
+#!/bin/bash
+
+# Times stream() over a million cells of one attribute, for each type and
+# transfer format. "in" runs a child that reads every message and answers
+# with an empty response, so the time is mostly SciDB converting the chunks;
+# "echo" runs a child that sends every message back, adding the conversion of
+# the responses. The children do as little as each format allows.
+#
+# The times are only comparable between builds of the plugin on the same
+# cluster: run this before and after a change to the conversion kernels.
+#
+#   ./benchmark.sh [repetitions]
+
+MY_DIR=`dirname $0`
+pushd $MY_DIR > /dev/null
+MY_DIR=`pwd`
+EX_DIR=`pwd`/../examples
+REPS=${1:-3}
+CELLS=1000000
+TMP_DIR=`mktemp -d`
+trap "rm -rf $TMP_DIR" EXIT
+
+cat > $TMP_DIR/df_in.R <<'EOF'
+con_in = file("stdin", "rb")
+con_out = pipe("cat", "wb")
+repeat
+{
+  input_list = unserialize(con_in)
+  writeBin(serialize(list(), NULL, xdr=FALSE, version=2), con_out)
+  flush(con_out)
+  if(length(input_list) == 0) break
+}
+close(con_in)
+EOF
+
+cat > $TMP_DIR/feather.py <<'EOF'
+import struct
+import sys
+
+echo = sys.argv[1] == 'echo'
+stdin = sys.stdin.buffer
+stdout = sys.stdout.buffer
+while True:
+    size = struct.unpack('<Q', stdin.read(8))[0]
+    message = stdin.read(size)
+    if echo:
+        stdout.write(struct.pack('<Q', size))
+        stdout.write(message)
+    else:
+        stdout.write(struct.pack('<Q', 0))
+    stdout.flush()
+    if size == 0:
+        break
+EOF
+
+# name, type, build expression
+TYPES="
+int64 int64 i
+double double i*1.5
+float float float(i)/3
+bool bool i%2=0
+string string 'x'+string(i)
+"
+
+run()
+{
+  local best=
+  for r in `seq $REPS`; do
+    local start=`date +%s%N`
+    if ! iquery -aq "op_count($1)" > /dev/null; then
+      printf "%-8s %-7s %-5s failed\n" $2 $3 $4
+      return
+    fi
+    local ms=$(( (`date +%s%N` - start) / 1000000 ))
+    if [ -z "$best" ] || [ $ms -lt $best ]; then best=$ms; fi
+  done
+  printf "%-8s %-7s %-5s %7d ms\n" $2 $3 $4 $best
+}
+
+echo "$TYPES" | while read name type expr; do
+  [ -z "$name" ] && continue
+  iquery -aq "remove(bench_$name)" > /dev/null 2>&1
+  iquery -anq "store(build(<v:$type>[i=1:$CELLS:0:100000], $expr), bench_$name)" > /dev/null
+done
+
+echo "format   type    way   best of $REPS"
+echo "$TYPES" | while read name type expr; do
+  [ -z "$name" ] && continue
+  run "stream(bench_$name, '$EX_DIR/stream_test_client SUMMARIZE')" tsv $name in
+  run "stream(bench_$name, 'Rscript $TMP_DIR/df_in.R', format:'df', types:'double')" df $name in
+  run "stream(bench_$name, 'python3 $TMP_DIR/feather.py in', format:'feather', types:'double')" feather $name in
+  case $name in
+  int64|double|string)
+    run "stream(bench_$name, 'cat', types:'$type')" tsv $name echo
+    run "stream(bench_$name, 'Rscript $EX_DIR/R_identity.R', format:'df', types:'$type')" df $name echo
+    run "stream(bench_$name, 'python3 $TMP_DIR/feather.py echo', format:'feather', types:'$type')" feather $name echo
+    ;;
+  esac
+done
+
+echo "$TYPES" | while read name type expr; do
+  [ -z "$name" ] && continue
+  iquery -aq "remove(bench_$name)" > /dev/null 2>&1
+done
+popd > /dev/null
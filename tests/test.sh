@@ -10,6 +10,7 @@ MY_DIR=`pwd`
 EX_DIR=`pwd`/../examples
 
 iquery -aq "remove(foo)" > /dev/null 2>&1
+iquery -aq "remove(stream_side)" > /dev/null 2>&1
 rm -rf $MY_DIR/test.out
 
 iquery -anq "store(build(<val:double>[i=1:800000:0:100000], i), foo)" > /dev/null 2>&1
@@ -41,6 +42,12 @@ iquery -aq "op_count(filter(list('queries'), inst=0))" >> $MY_DIR/test.out 2>&1
 
 iquery -ocsv -aq "stream(build(<val:string> [i=1:10:0:5], i), 'Rscript $EX_DIR/tsv_R_client.R')" >> $MY_DIR/test.out 2>&1
 iquery -aq "op_count(stream(foo, 'Rscript $EX_DIR/tsv_R_client.R'))" >> $MY_DIR/test.out 2>&1
+#The first query fills the input cache, the second streams the cached messages
+iquery -aq "op_count(stream(foo, 'Rscript $EX_DIR/tsv_R_client.R', input_cache:true))" >> $MY_DIR/test.out 2>&1
+iquery -aq "op_count(stream(foo, 'Rscript $EX_DIR/tsv_R_client.R', input_cache:true))" >> $MY_DIR/test.out 2>&1
+#Likewise the first query fills the result cache and the second replays the responses
+iquery -aq "op_count(stream(foo, 'Rscript $EX_DIR/tsv_R_client.R', cache:true))" >> $MY_DIR/test.out 2>&1
+iquery -aq "op_count(stream(foo, 'Rscript $EX_DIR/tsv_R_client.R', cache:true))" >> $MY_DIR/test.out 2>&1
 
 iquery -aq "remove(foo)" > /dev/null 2>&1
 
@@ -75,6 +82,39 @@ iquery -ocsv -aq "stream(
  ),
  'Rscript $EX_DIR/R_identity.R', format:'df', types:('int32','double','int32','string'), names:('a','b','c','d'))" >> $MY_DIR/test.out 2>&1
 
+iquery -ocsv -aq "stream(build(<a:double>[i=1:4:0:4], i), build(<b:double>[i=1:4:0:4], i*10), 'Rscript $EX_DIR/R_identity.R', format:'df', types:('double','double'), names:('a','b'), zip:true)" >> $MY_DIR/test.out 2>&1
+
+#The first query caches the side input, the second has the child read the cached file
+iquery -anq "store(build(<m:double>[i=0:0:0:1], 100), stream_side, distribution:replicated)" > /dev/null 2>&1
+iquery -ocsv -aq "stream(build(<v:double>[i=1:4:0:4], i), stream_side, 'R --slave -e \"library(scidbstrm); m <- getChunk()\$m; map(function(x) data.frame(v=x\$v+m))\"', format:'df', types:'double', names:'v', side_cache:true)" >> $MY_DIR/test.out 2>&1
+iquery -ocsv -aq "stream(build(<v:double>[i=1:4:0:4], i), stream_side, 'R --slave -e \"library(scidbstrm); m <- getChunk()\$m; map(function(x) data.frame(v=x\$v+m))\"', format:'df', types:'double', names:'v', side_cache:true)" >> $MY_DIR/test.out 2>&1
+iquery -aq "remove(stream_side)" > /dev/null 2>&1
+
+#TSV responses parsed into typed attributes, with \N as null
+iquery -ocsv -aq "stream(apply(build(<a:double>[i=1:3:0:3], i), b, iif(i=2, string(null), 'x'+string(i))), 'cat', types:('double','string'), names:('a','b'))" >> $MY_DIR/test.out 2>&1
+
+#DF round trip of bool, int64, float and datetime attributes, with int64 as double and as integer64
+iquery -ocsv -aq "stream(apply(build(<a:int64>[i=1:3:0:3], iif(i=2, null, i*10)), b, i=2, c, float(i)/2, d, datetime('2020-01-0'+string(i)+' 00:00:00')), 'Rscript $EX_DIR/R_identity.R', format:'df', types:('int64','bool','float','datetime'))" >> $MY_DIR/test.out 2>&1
+iquery -ocsv -aq "stream(apply(build(<a:int64>[i=1:3:0:3], iif(i=2, null, i*10)), b, i=2, c, float(i)/2, d, datetime('2020-01-0'+string(i)+' 00:00:00')), 'Rscript $EX_DIR/R_identity.R', format:'df', types:('int64','bool','float','datetime'), int64_as:'integer64')" >> $MY_DIR/test.out 2>&1
+
+#DF round trip of a string attribute sent as a factor, whose levels come back as strings
+iquery -ocsv -aq "stream(apply(build(<a:double>[i=1:4:0:4], i), b, iif(i=3, string(null), iif(i%2=0, 'even', 'odd'))), 'Rscript $EX_DIR/R_identity.R', format:'df', types:('double','string'), dictionary:'always')" >> $MY_DIR/test.out 2>&1
+
+#Every key comes out of exactly one message when the messages hold whole groups
+iquery -ocsv -aq "aggregate(stream(build(<k:double>[i=1:100:0:10], i%5), 'R --slave -e \"library(scidbstrm); map(function(x) data.frame(k=unique(x\$k)))\"', format:'df', types:'double', names:'k', partition_by:'k'), count(*))" >> $MY_DIR/test.out 2>&1
+
+#Every message holds its rows in ascending order of the ordered_by dimension
+iquery -ocsv -aq "aggregate(stream(build(<v:double>[i=1:40:0:5], i), 'R --slave -e \"library(scidbstrm); map(function(x) data.frame(sorted=as.double(!is.unsorted(x\$v))))\"', format:'df', types:'double', names:'sorted', ordered_by:'i'), min(sorted))" >> $MY_DIR/test.out 2>&1
+
+#About half of the cells, and about half of the chunks, are streamed when sampling with 0.5
+iquery -ocsv -aq "project(apply(aggregate(stream(build(<v:double>[i=1:1000:0:100], i), 'R --slave -e \"library(scidbstrm); map(function(x) data.frame(n=nrow(x)))\"', format:'df', types:'double', names:'n', sample:0.5, seed:7), sum(n) as total), ok, iif(total > 400 and total < 600, 1, 0)), ok)" >> $MY_DIR/test.out 2>&1
+iquery -ocsv -aq "project(apply(aggregate(stream(build(<v:double>[i=1:1000:0:10], i), 'R --slave -e \"library(scidbstrm); map(function(x) data.frame(n=nrow(x)))\"', format:'df', types:'double', names:'n', sample_chunks:0.5, seed:7), count(*) as total), ok, iif(total > 30 and total < 70, 1, 0)), ok)" >> $MY_DIR/test.out 2>&1
+
+#A child that asks to stop after its first response gets only the first of the ten chunks: TSV, DF with a stop attribute, and DF through requestStop()
+iquery -ocsv -aq "op_count(stream(_sg(build(<v:double>[i=1:100:0:10], i), 2, 0), '$EX_DIR/stream_test_client STOP'))" >> $MY_DIR/test.out 2>&1
+iquery -ocsv -aq "op_count(stream(_sg(build(<v:double>[i=1:100:0:10], i), 2, 0), 'Rscript $EX_DIR/R_stop.R', format:'df', types:'double'))" >> $MY_DIR/test.out 2>&1
+iquery -ocsv -aq "op_count(stream(_sg(build(<v:double>[i=1:100:0:10], i), 2, 0), 'R --slave -e \"library(scidbstrm); map(function(x) { requestStop(); x })\"', format:'df', types:'double', names:'v'))" >> $MY_DIR/test.out 2>&1
+
 #Conversion from client->scidb and then scidb->iquery adds extra backslashes; bear with us!
 iquery -otsv -aq "stream(apply(build(<a:string> [i=0:0:0:1], '\n \r \t \ '), b, string(null)), '$EX_DIR/stream_test_client')" >> $MY_DIR/test.out 2>&1
 
@@ -21,6 +21,7 @@
 #
 # END_COPYRIGHT
 
+import datetime
 import numpy
 import pytest
 import scidbpy
@@ -33,7 +34,15 @@ def db():
 
 # SciDB Supported Types
 scidb_types = (
+    'int8',
+    'int16',
+    'int32',
     'int64',
+    'uint8',
+    'uint16',
+    'uint32',
+    'uint64',
+    'float',
     'double',
     'string',
     'binary',
@@ -42,6 +51,7 @@ scidb_types = (
 
 # NumPy Type Map: SciDB Type -> NumPy Type
 np_type_map = {
+    'float': 'float32',
     'string': 'O',
     'binary': 'O',
 }
@@ -49,7 +59,15 @@ np_type_map = {
 
 # Python Type Map: SciDB Type -> Python Type
 py_type_map = {
+    'int8': 'int',
+    'int16': 'int',
+    'int32': 'int',
     'int64': 'int',
+    'uint8': 'int',
+    'uint16': 'int',
+    'uint32': 'int',
+    'uint64': 'int',
+    'float': 'float',
     'double': 'float',
     'string': 'str',
     'binary': 'bytes',
@@ -159,3 +177,168 @@ scidbstrm.map(f)"',
         )''',
         fetch=True)
     assert df.shape == (10000, 4)
+
+
+def test_stop(db):
+    """Each child asks to stop after its first chunk, so it never gets the
+    rest."""
+    df = db.iquery(
+        '''
+        stream(
+          build(<x:int64>[i=0:99:0:1], i),
+          'python3 -uc "
+import scidbstrm
+def f(x):
+  scidbstrm.request_stop()
+  return x
+scidbstrm.map(f)"',
+         format:'feather',
+         types:'int64'
+        )''',
+        fetch=True)
+    assert 0 < df.shape[0] < 100
+
+
+def test_full_stream_responses(db):
+    """A child that sends a complete Arrow stream, schema included, in
+    every response is still understood."""
+    df = db.iquery(
+        '''
+        stream(
+          build(<x:int64>[i=0:9:0:2], i),
+          'python3 -uc "
+import pyarrow, scidbstrm, struct
+while True:
+  df = scidbstrm.read()
+  if df is None:
+    scidbstrm.write()
+    break
+  buf = pyarrow.BufferOutputStream()
+  table = pyarrow.Table.from_pandas(df).replace_schema_metadata()
+  writer = pyarrow.RecordBatchStreamWriter(buf, table.schema)
+  writer.write_table(table)
+  writer.close()
+  byt = buf.getvalue().to_pybytes()
+  scidbstrm.stdout.write(struct.pack(\\"<Q\\", len(byt)))
+  scidbstrm.stdout.write(byt)"',
+         format:'feather',
+         types:'int64'
+        )''',
+        fetch=True)
+    assert df.shape == (10, 4)
+
+
+def test_many_batches(db):
+    """Every response holds one record batch per row, each of which is
+    stored as its own chunk."""
+    res = db.iquery(
+        '''
+        stream(
+          build(<x:int64>[i=0:9:0:5], i),
+          'python3 -uc "
+import pyarrow, scidbstrm, struct
+while True:
+  df = scidbstrm.read()
+  if df is None:
+    scidbstrm.write()
+    break
+  buf = pyarrow.BufferOutputStream()
+  table = pyarrow.Table.from_pandas(df).replace_schema_metadata()
+  writer = pyarrow.RecordBatchStreamWriter(buf, table.schema)
+  for batch in table.to_batches(max_chunksize=1):
+    writer.write_batch(batch)
+  writer.close()
+  byt = buf.getvalue().to_pybytes()
+  scidbstrm.stdout.write(struct.pack(\\"<Q\\", len(byt)))
+  scidbstrm.stdout.write(byt)"',
+         format:'feather',
+         types:'int64'
+        )''',
+        fetch=True)
+    assert sorted(res['a0'].tolist()) == list(range(10))
+    assert len(set(zip(res['instance_id'], res['chunk_no']))) == 10
+
+
+@pytest.mark.parametrize('codec', ('lz4', 'zstd'))
+def test_compression(db, codec):
+    res = db.iquery("""
+        stream(
+          apply(build(<x:int64>[i=0:9:0:5], i), y, 'foo' + string(i)),
+          'python3 -u /stream/tests/scripts/any_chunks.py',
+          format:'feather',
+          types:('int64','string'),
+          compression:'{codec}')""".format(codec=codec),
+                    fetch=True,
+                    atts_only=True)
+    assert sorted(res['a0'].tolist()) == list(range(10))
+    assert sorted(res['a1'].tolist()) == sorted(
+        'foo{}'.format(i) for i in range(10))
+
+
+@pytest.mark.parametrize('dictionary', ('auto', 'always'))
+def test_dictionary(db, dictionary):
+    res = db.iquery("""
+        stream(
+          apply(build(<x:int64>[i=0:99:0:50], i), y, 'foo' + string(i % 2)),
+          'python3 -u /stream/tests/scripts/any_chunks.py',
+          format:'feather',
+          types:('int64','string'),
+          dictionary:'{dictionary}')""".format(dictionary=dictionary),
+                    fetch=True,
+                    atts_only=True)
+    assert sorted(res['a0'].tolist()) == list(range(100))
+    assert sorted(res['a1'].tolist()) == sorted(
+        'foo{}'.format(i % 2) for i in range(100))
+
+
+def test_bool_datetime(db):
+    res = db.iquery("""
+        stream(
+          apply(build(<x:int32>[i=0:9:0:5], int32(i)),
+                y, bool(i % 2),
+                z, datetime('2021-01-01 00:00:00')),
+          'python3 -u /stream/tests/scripts/any_chunks.py',
+          format:'feather',
+          types:('int32','bool','datetime'))""",
+                    fetch=True,
+                    atts_only=True)
+    assert sorted(res['a0'].tolist()) == list(range(10))
+    assert sorted(res['a1'].tolist()) == [False] * 5 + [True] * 5
+    assert set(res['a2'].astype('datetime64[s]').tolist()) == {
+        datetime.datetime(2021, 1, 1)}
+
+
+def test_numeric_conversion(db):
+    """A float64 column, as pandas makes of integers next to missing
+    values, is read into integer output with NaN as null."""
+    res = db.iquery(
+        '''
+        stream(
+          build(<x:int64>[i=0:9:0:10], i),
+          'python3 -uc "
+import numpy, scidbstrm
+def f(df):
+  return df.assign(x=df.x.where(df.x % 2 == 0, numpy.nan))
+scidbstrm.map(f)"',
+         format:'feather',
+         types:'int32'
+        )''',
+        fetch=True,
+        atts_only=True)
+    assert sorted(res['a0'].dropna().tolist()) == [0, 2, 4, 6, 8]
+    assert res['a0'].isnull().sum() == 5
+
+
+def test_numeric_out_of_range(db):
+    """A value that does not fit the output type fails the query rather
+    than wrapping around."""
+    with pytest.raises(Exception, match='out of range'):
+        db.iquery(
+            '''
+            stream(
+              build(<x:int64>[i=0:9:0:10], i * 100),
+              'python3 -u /stream/tests/scripts/any_chunks.py',
+              format:'feather',
+              types:'int8'
+            )''',
+            fetch=True)